@@ -37,7 +37,13 @@ namespace meen_hw
 		bpp,			//< The configuration value of bpp is invalid.
 		colour,			//< The configuration value of colour is invalid.
 		orientation,	//< The configuration value of orientation is invalid.
-		json_parse		//< The JSON configuration file is malformed.
+		json_parse,		//< The JSON configuration file is malformed.
+		scale,			//< The configuration value of scale is invalid.
+		format,			//< The configuration value of format is invalid.
+		overlay,		//< The configuration value of overlay is invalid.
+		timing,			//< The configuration value of timing is invalid.
+		frame_skip,		//< The configuration value of frame-skip is invalid.
+		audio_rate		//< The configuration value of audio-rate is invalid.
 	};
 
 	/** The custom meen_hw error category
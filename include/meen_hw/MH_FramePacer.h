@@ -0,0 +1,235 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEEN_HW_MH_FRAMEPACER_H
+#define MEEN_HW_MH_FRAMEPACER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#ifdef ENABLE_MH_RP2040
+	#include <pico/time.h>
+#else
+	#include <thread>
+	#ifdef __linux__
+		#include <cerrno>
+		#include <time.h>
+	#endif
+#endif // ENABLE_MH_RP2040
+
+#include "meen_hw/MH_Mutex.h"
+
+namespace meen_hw
+{
+	/** Frame pacing statistics
+
+		Errors are the time the pacer returned minus the deadline, positive when late.
+	*/
+	struct MH_PacingStats
+	{
+		uint64_t ticks;				/**< Calls to Pace. */
+		uint64_t late;				/**< Calls to Pace that were already past their deadline, the caller is catching up. */
+		uint64_t resyncs;			/**< Times the schedule was restarted because the caller fell too far behind. */
+		int64_t lastErrorNs;		/**< The error of the most recent call to Pace. */
+		int64_t maxErrorNs;			/**< The largest absolute error of a call that waited. */
+		int64_t meanAbsErrorNs;		/**< The mean absolute error of the calls that waited. */
+	};
+
+	/** Paces emulation to the host monotonic clock.
+
+		Maps the emulated cpu cycle count onto absolute host deadlines, deadline
+		n is always computed from the start of the schedule so rounding never
+		accumulates into drift. Pace sleeps until shortly before the deadline
+		with an absolute sleep (clock_nanosleep on Linux, sleep_until elsewhere)
+		and spins the remaining spinTail, so the cpu is idle for most of each
+		frame while the wake up lands within microseconds of the deadline.
+
+		A caller that is behind is not slowed down until it catches up, unless it
+		falls more than maxLag behind (the host stalled, a debugger break), then
+		the schedule restarts from the current time instead of racing to catch up.
+
+		@code
+		MH_FramePacer pacer;
+		io->SetOptions("{\"timing\":\"cycles\"}");
+		pacer.Start(cycles);
+
+		while (running)
+		{
+			cycles += cpu.Execute(io->CyclesUntilInterrupt(cycles));
+
+			if (auto isr = io->GenerateInterrupt(0, cycles))
+			{
+				cpu.Interrupt(isr);
+				pacer.Pace(cycles);
+			}
+		}
+		@endcode
+
+		@remark		Not thread safe, call from the emulation thread.
+	*/
+	class MH_FramePacer final
+	{
+	private:
+		uint64_t clockHz_;
+		std::chrono::nanoseconds spinTail_;
+		std::chrono::nanoseconds maxLag_;
+
+		/** The host time and cycle count the schedule started at */
+		std::chrono::nanoseconds epoch_{};
+		uint64_t epochCycles_{};
+
+		uint64_t waits_{};
+		int64_t sumAbsErrorNs_{};
+		MH_PacingStats stats_{};
+
+		/** The host time an emulated cycle count is due
+
+			A cycle count from before the schedule started is due at the start.
+		*/
+		std::chrono::nanoseconds Deadline(uint64_t cycles) const
+		{
+			if (cycles < epochCycles_)
+			{
+				return epoch_;
+			}
+
+			auto delta = cycles - epochCycles_;
+			// Split into whole seconds so the multiply can't overflow on long runs.
+			auto ns = delta / clockHz_ * 1000000000 + delta % clockHz_ * 1000000000 / clockHz_;
+			return epoch_ + std::chrono::nanoseconds(ns);
+		}
+
+		/** Sleep until an absolute host time */
+		static void SleepUntil(std::chrono::nanoseconds time)
+		{
+#ifdef ENABLE_MH_RP2040
+			sleep_until(from_us_since_boot(time.count() / 1000));
+#elif defined(__linux__)
+			timespec ts{ static_cast<time_t>(time.count() / 1000000000), static_cast<long>(time.count() % 1000000000) };
+			// Only a signal is retried, any other error returns and Pace spins the rest.
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+#else
+			std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(time)));
+#endif
+		}
+
+	public:
+		/** The i8080 arcade cpu clock in Hz */
+		static constexpr uint64_t i8080ArcadeClock = 1996800;
+
+		/** Constructor
+
+			@param	clockHz		The emulated cpu clock that cycle counts are measured in.
+			@param	spinTail	How long before each deadline to stop sleeping and spin, enough
+								to cover the host's sleep wake up latency.
+			@param	maxLag		How far behind the caller may fall before the schedule is restarted.
+		*/
+		explicit MH_FramePacer(uint64_t clockHz = i8080ArcadeClock, std::chrono::nanoseconds spinTail = std::chrono::microseconds(200), std::chrono::nanoseconds maxLag = std::chrono::milliseconds(50))
+			: clockHz_{ clockHz }
+			, spinTail_{ spinTail }
+			, maxLag_{ maxLag }
+		{
+			Start(0);
+		}
+
+		/** The host monotonic clock
+
+			@return		std::chrono::steady_clock, or the time since boot on the RP2040.
+		*/
+		static std::chrono::nanoseconds Now()
+		{
+#ifdef ENABLE_MH_RP2040
+			return std::chrono::microseconds(time_us_64());
+#else
+			return std::chrono::steady_clock::now().time_since_epoch();
+#endif
+		}
+
+		/** Start the schedule
+
+			@param	cycles		The current cycle count, it is due now.
+		*/
+		void Start(uint64_t cycles)
+		{
+			epoch_ = Now();
+			epochCycles_ = cycles;
+		}
+
+		/** Wait until an emulated cycle count is due
+
+			@param	cycles		The cycle count the caller has emulated up to, usually the cycle
+								count of the interrupt that was just generated.
+
+			@return				The pacing error, the time Pace returned minus the deadline.
+								Positive when the caller was already late.
+		*/
+		std::chrono::nanoseconds Pace(uint64_t cycles)
+		{
+			auto deadline = Deadline(cycles);
+			auto now = Now();
+			stats_.ticks++;
+
+			if (now >= deadline)
+			{
+				if (now - deadline > maxLag_)
+				{
+					stats_.resyncs++;
+					Start(cycles);
+				}
+
+				stats_.late++;
+				stats_.lastErrorNs = (now - deadline).count();
+				return now - deadline;
+			}
+
+			if (deadline - now > spinTail_)
+			{
+				SleepUntil(deadline - spinTail_);
+			}
+
+			while ((now = Now()) < deadline)
+			{
+				MH_Pause();
+			}
+
+			auto error = (now - deadline).count();
+			waits_++;
+			sumAbsErrorNs_ += error < 0 ? -error : error;
+			stats_.lastErrorNs = error;
+			stats_.maxErrorNs = std::max(stats_.maxErrorNs, error < 0 ? -error : error);
+			stats_.meanAbsErrorNs = sumAbsErrorNs_ / static_cast<int64_t>(waits_);
+			return now - deadline;
+		}
+
+		/** Pacing statistics
+
+			@return		The statistics since the pacer was constructed.
+		*/
+		MH_PacingStats Stats() const
+		{
+			return stats_;
+		}
+	};
+} // namespace meen_hw
+
+#endif // MEEN_HW_MH_FRAMEPACER_H
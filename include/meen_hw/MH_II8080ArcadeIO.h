@@ -23,11 +23,33 @@ SOFTWARE.
 #ifndef MEEN_HW_MH_II8080ARCADEIO_H
 #define MEEN_HW_MH_II8080ARCADEIO_H
 
+#include <functional>
 #include <span>
 #include <system_error>
 
 namespace meen_hw
 {
+	/** A rectangular region of the destination vram
+
+		Measured in pixels from the top left of the destination.
+	*/
+	struct MH_Rect
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+	};
+
+	/** Parallel blit executor
+
+		Called by `BlitVRAMParallel` with the number of independent bands to blit
+		and a function that blits a single band. The executor must call blitBand
+		exactly once for each band in [0, bandCount), on any thread(s), and only
+		return once all bands have completed.
+	*/
+	using MH_BlitExecutor = std::function<void(int bandCount, const std::function<void(int band)>& blitBand)>;
+
 	/** Intel 8080 arcade hardware emulation.
 
 		Designed to be used as a helper class for use
@@ -124,6 +146,9 @@ namespace meen_hw
 			@param	data		The data to write to the output device.
 
 			@return				Audio that requires rendering as described above.
+
+			@remark				Port 3 and 5 writes also drive the built in sound
+								synthesiser, see `RenderAudio`.
 		*/
 		virtual uint8_t WritePort(uint16_t port, uint8_t data) = 0;
 
@@ -134,12 +159,73 @@ namespace meen_hw
 			This informs the ROM that it is safe to draw to the
 			top and bottom of the video ram.
 
+			With the default "time" timing an interrupt is returned whenever
+			currTime changes. With "cycles" timing (see `SetOptions`) currTime
+			is ignored and the interrupts fire every 16640 cycles of the
+			1.9968 MHz i8080 clock, interrupt 1 when cycles passes an odd
+			multiple and interrupt 2 when it passes an even multiple. When
+			several interrupts were passed since the last call only the most
+			recent is returned.
+
+			@param	currTime	The current cpu time, used by "time" timing.
+			@param	cycles		The total number of cycles the cpu has executed, used by "cycles" timing.
+
 			@return				0: no interrupt has occured.
 								1: the 'beam' is near the centre of the screen.
 								2: the 'beam' is at the end (vBlank). 
 		*/
 		virtual uint8_t GenerateInterrupt(uint64_t currTime, uint64_t cycles) = 0;
 
+		/** The number of cycles until the next screen interrupt
+
+			Lets the cpu loop run a straight batch of instructions and only call
+			`GenerateInterrupt` once the batch reaches the next interrupt.
+
+			@param	cycles		The total number of cycles the cpu has executed.
+
+			@return				The number of cycles the cpu can execute before `GenerateInterrupt`
+								returns the next interrupt, 0 if it is already due. Always 0 with
+								"time" timing, where `GenerateInterrupt` must be polled.
+		*/
+		virtual uint64_t CyclesUntilInterrupt(uint64_t cycles) const = 0;
+
+		/** Whether the current frame is skipped
+
+			A frame starts with interrupt 1, the blit methods do nothing while the
+			current frame is one of the N of every M frames skipped by the frame-skip
+			option. Lets a headless or fast forwarding frontend skip presenting it too.
+
+			@return				true if the blit methods will skip the current frame.
+		*/
+		virtual bool FrameSkipped() const = 0;
+
+		/** The scanline the beam is on
+
+			A raster model driven by the emulated cycle count: each scanline takes
+			128 cycles and a frame is 260 scanlines, 224 visible (one per source
+			vram row) followed by 36 of vBlank. It is in phase with "cycles" timing,
+			interrupt 2 fires as the beam reaches scanline 224 and interrupt 1 near
+			scanline 94.
+
+			@param	cycles		The total number of cycles the cpu has executed.
+
+			@return				The scanline, 0 to 223 while drawing, 224 to 259 during vBlank.
+		*/
+		virtual int GetScanline(uint64_t cycles) const = 0;
+
+		/** Render the discrete sound circuits
+
+			Synthesises the SX0 - SX10 sounds triggered by the port 3 and 5
+			writes made since the last call into signed 16 bit mono samples
+			at the audio-rate option's sample rate. The samples are silent
+			while the amplifier (port 3 bit 5) is disabled. May be called
+			from an audio thread while the cpu thread calls `WritePort` or
+			`SetOptions`.
+
+			@param	samples		Receives the next samples.
+		*/
+		virtual void RenderAudio(std::span<int16_t> samples) = 0;
+
 		/** Blit options
 
 			The options applied to the output buffer when `BlitVRAM` is called.
@@ -148,9 +234,25 @@ namespace meen_hw
 
 									Configuration options are as follows:
 
-									blit-bpp: [1(default)|8] 
+									blit-bpp: [1(default)|8|16|32] 
 									blit-colour: ["white"(default)|"red"|"green"|"blue"|"random"|hex]
+									where hex is either a RGB332 byte or a RRGGBB triplet.
+									blit-format: ["rgb565"(default)|"bgr565"] for 16 bpp,
+									["argb8888"(default)|"abgr8888"|"rgba8888"|"bgra8888"] for 32 bpp.
 									blit-orientation: ["cocktail"(default)|"upright"]
+									blit-overlay: ["none"(default)|"invaders"|[{"x","y","width","height","colour"}, ...]]
+									coloured bands of the upright screen (224 x 256) drawn in place of blit-colour,
+									band edges must be multiples of 8.
+									blit-scale: [1(default)|2|3|4] each source pixel is written to a
+									scale x scale block of the destination (nearest neighbour).
+									timing: ["time"(default)|"cycles"] how `GenerateInterrupt` decides
+									when an interrupt is due. "cycles" derives the interrupts purely from
+									the emulated cycle count, the emulation is then unthrottled and runs
+									as fast as the host allows unless the caller paces it.
+									frame-skip: [N, M] the blit methods skip N of every M frames,
+									0 <= N < M <= 255, [0, 1](default) blits every frame.
+									audio-rate: [8000 - 192000] the `RenderAudio` sample rate in Hz,
+									44100(default), applied by the next `RenderAudio` call.
 		*/
 		virtual std::error_code SetOptions(const char* options) = 0;
 
@@ -169,11 +271,96 @@ namespace meen_hw
 		*/
 		virtual void BlitVRAM(std::span<uint8_t> dstVRAM, int dstVRAMRowBytes, std::span<uint8_t> srcVRAM) = 0;
 
+		/** Write only the changed regions of the i8080 arcade vram to a destination buffer.
+
+			A copy of the previously blitted source vram is kept and compared against
+			srcVRAM, only the scanlines (cocktail) or columns (upright) that have changed
+			are blitted. The result is identical to `BlitVRAM` as long as dstVRAM holds
+			the output of the previous incremental blit.
+
+			@param	dstVRAM			The video memory to write to (texture memory), it must hold
+									the output of the previous call to this method.
+			@param	dstVRAMRowBytes	The width of each dst vram scanline in bytes.
+			@param	srcVRAM			The video ram to copy.
+			@param	dirtyRects		The destination regions that were written to. When there are
+									more regions than rects the last rect is grown to cover the
+									remaining regions. Can be empty if the regions are not required.
+
+			@return					The number of dirtyRects that were written.
+
+			@remark					The first call, and the first call after `SetOptions`, blits
+									the entire vram.
+		*/
+		virtual int BlitVRAMIncremental(std::span<uint8_t> dstVRAM, int dstVRAMRowBytes, std::span<uint8_t> srcVRAM, std::span<MH_Rect> dirtyRects) = 0;
+
+		/** Write the i8080 arcade vram to a destination buffer using multiple threads.
+
+			The destination is split into independent bands, scanline ranges for a cocktail
+			orientation and column ranges for an upright orientation, which are blitted
+			concurrently. The result is identical to `BlitVRAM`.
+
+			@param	dstVRAM			The video memory to write to (texture memory).
+			@param	dstVRAMRowBytes	The width of each dst vram scanline in bytes.
+			@param	srcVRAM			The video ram to copy.
+			@param	executor		Runs the bands, 32 source rows (4 tiles) each, 7 for the full
+									vram. When empty a worker pool sized to the host's hardware
+									concurrency is created on first use and owned by this
+									instance, on platforms without thread support the bands
+									are blitted serially.
+
+			@see	MH_BlitExecutor
+		*/
+		virtual void BlitVRAMParallel(std::span<uint8_t> dstVRAM, int dstVRAMRowBytes, std::span<uint8_t> srcVRAM, const MH_BlitExecutor& executor) = 0;
+
+		/** Write one half of the i8080 arcade vram to a destination buffer.
+
+			Blits the part of the screen the beam has just finished drawing, so
+			it can be called with the value returned from `GenerateInterrupt`.
+			Interrupt 1 fires as the `GetScanline` beam reaches scanline 94, it
+			blits the first 88 source scanlines (the whole 8 row tiles the beam
+			has drawn) and interrupt 2 (vblank) blits the remaining 136. Calling
+			this for both interrupts produces the same output as `BlitVRAM`,
+			while each call does part of the work. Use `BlitVRAMToBeam` to blit
+			at any other point of the frame.
+
+			@param	dstVRAM			The video memory to write to (texture memory), shared by both halves.
+			@param	dstVRAMRowBytes	The width of each dst vram scanline in bytes.
+			@param	srcVRAM			The video ram to copy.
+			@param	isr				The interrupt that was just generated, 1 or 2. Any other
+									value blits nothing.
+
+			@return					The destination region that was written to, the top (cocktail)
+									or left (upright) part for interrupt 1. Empty when nothing
+									was blitted.
+		*/
+		virtual MH_Rect BlitVRAMHalf(std::span<uint8_t> dstVRAM, int dstVRAMRowBytes, std::span<uint8_t> srcVRAM, uint8_t isr) = 0;
+
+		/** Write the i8080 arcade vram rows the beam has passed to a destination buffer.
+
+			Races the beam of the `GetScanline` raster model: blits the source rows the
+			beam has drawn since the previous call, so each row can be presented as soon
+			as the beam leaves it instead of buffering a whole frame. When the beam has
+			started a new frame the rows left over from the previous frame are blitted
+			first. Calling this often enough produces the same output as `BlitVRAM`.
+
+			@param	dstVRAM			The video memory to write to (texture memory), shared by every call.
+			@param	dstVRAMRowBytes	The width of each dst vram scanline in bytes.
+			@param	srcVRAM			The video ram to copy.
+			@param	cycles			The total number of cycles the cpu has executed.
+
+			@return					The destination region that was written to, empty when the beam
+									has not passed a new row. An upright orientation only blits
+									whole 8 row tiles.
+
+			@remark					`SetOptions` restarts the beam tracking.
+		*/
+		virtual MH_Rect BlitVRAMToBeam(std::span<uint8_t> dstVRAM, int dstVRAMRowBytes, std::span<uint8_t> srcVRAM, uint64_t cycles) = 0;
+
 		/** Output video width in pixels
 
-			The option `blit-orientation` will determine this value. For a cocktail
-			orientation (default), it will be 256 pixels. For an upright orientation
-			it will be 224 pixels.
+			The options `blit-orientation` and `blit-scale` will determine this value.
+			For a cocktail orientation (default), it will be 256 pixels. For an upright
+			orientation it will be 224 pixels. The value is multiplied by the scale.
 
 			@return				The width of the dstVRAM passed to BlitVRAM. 
 		*/
@@ -181,9 +368,9 @@ namespace meen_hw
 
 		/** Output video height in pixels
 
-			The option `blit-orientation` will determine this value. For a cocktail
-			orientation (default), it will be 224 pixels. For an upright orientation
-			it will be 256 pixels.
+			The options `blit-orientation` and `blit-scale` will determine this value.
+			For a cocktail orientation (default), it will be 224 pixels. For an upright
+			orientation it will be 256 pixels. The value is multiplied by the scale.
 
 			@return				The height of the dstVRAM passed to BlitVRAM.
 		*/
@@ -1,6 +1,9 @@
 #ifndef MEEN_HW_MH_MUTEX_H
 #define MEEN_HW_MH_MUTEX_H
 
+#include <atomic>
+#include <cstdint>
+
 #ifdef ENABLE_MH_RP2040
 	#include <pico/mutex.h>
 	using mh_mutex = mutex_t;
@@ -9,8 +12,13 @@
 	#define MH_MUTEX_LOCK(m) mutex_enter_blocking(&m)
 	#define MH_MUTEX_TRY_LOCK(m) mutex_try_enter(&m, nullptr)
 	#define MH_MUTEX_UNLOCK(m) mutex_exit(&m)
+	#include <pico/sem.h>
+	#include <hardware/sync.h>
 #else // use std::mutex
+	#include <chrono>
+	#include <condition_variable>
 	#include <mutex>
+	#include <thread>
 	using mh_mutex = std::mutex;
 
 	#define MH_MUTEX_INIT(m)
@@ -19,8 +27,115 @@
 	#define MH_MUTEX_UNLOCK(m) m.unlock()
 #endif // ENABLE_MH_RP2040
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#include <immintrin.h>
+#endif
+
 namespace meen_hw
 {
+	/** Tell the cpu that this is a spin wait loop */
+	inline void MH_Pause()
+	{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+		_mm_pause();
+#elif defined(__arm__) || defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+
+#ifndef ENABLE_MH_RP2040
+	/** An adaptive spin then park mutex
+
+		The resource pool critical sections are a few dozen nanoseconds long, far
+		shorter than a futex sleep and wake. The lock spins with a pause backoff,
+		yielding the cpu once the backoff is spent, for a bounded number of
+		iterations before parking on the atomic. Unlock only wakes a thread when
+		one is parked.
+
+		It is opt in, pass it as the lock type of a MH_ResourcePool. On a single
+		core host with 2 threads the lock contention benchmark measured a p99 of
+		182ns against 115ns for std::mutex, so std::mutex stays the hosted default.
+		Run the benchmark on the target host to see if it wins there.
+	*/
+	class MH_AdaptiveMutex
+	{
+	private:
+		/** 0 unlocked, 1 locked, 2 locked with parked waiters */
+		std::atomic<uint32_t> state_{};
+
+		static constexpr int spinCount_ = 64;
+		static constexpr int pauseLimit_ = 16;
+
+	public:
+		void lock()
+		{
+			uint32_t state = 0;
+
+			if (state_.compare_exchange_strong(state, 1, std::memory_order_acquire) == true)
+			{
+				return;
+			}
+
+			for (int spin = 0; spin < spinCount_; spin++)
+			{
+				if (state == 0)
+				{
+					if (state_.compare_exchange_weak(state, 1, std::memory_order_acquire) == true)
+					{
+						return;
+					}
+
+					continue;
+				}
+
+				if (spin < pauseLimit_)
+				{
+					for (int pause = 0; pause < 1 << (spin / 4); pause++)
+					{
+						MH_Pause();
+					}
+				}
+				else
+				{
+					std::this_thread::yield();
+				}
+
+				state = state_.load(std::memory_order_relaxed);
+			}
+
+			// Park, marking the lock as contended so unlock knows to wake us
+			if (state != 2)
+			{
+				state = state_.exchange(2, std::memory_order_acquire);
+			}
+
+			while (state != 0)
+			{
+				state_.wait(2, std::memory_order_relaxed);
+				state = state_.exchange(2, std::memory_order_acquire);
+			}
+		}
+
+		bool try_lock()
+		{
+			uint32_t state = 0;
+			return state_.compare_exchange_strong(state, 1, std::memory_order_acquire);
+		}
+
+		void unlock()
+		{
+			if (state_.exchange(0, std::memory_order_release) == 2)
+			{
+				state_.notify_one();
+			}
+		}
+	};
+#endif // ENABLE_MH_RP2040
+
+	/** The default pool mutex
+
+		A pico mutex on the RP2040, std::mutex on hosted targets.
+	*/
 	class MH_Mutex
 	{
 	private:
@@ -49,14 +164,228 @@ namespace meen_hw
 		}
 	};
 
-	// Probably need a CritSec too
+	/** An auto reset event
+
+		Notify wakes a single waiter, or the next thread to wait if there are none.
+		Notifications do not accumulate, notifying a signalled event does nothing.
+	*/
+	class MH_Event
+	{
+	private:
+#ifdef ENABLE_MH_RP2040
+		semaphore_t sem_;
+#else
+		std::mutex mtx_;
+		std::condition_variable cv_;
+		bool signalled_{};
+#endif
+	public:
+		MH_Event()
+		{
+#ifdef ENABLE_MH_RP2040
+			sem_init(&sem_, 0, 1);
+#endif
+		}
+
+		void Notify()
+		{
+#ifdef ENABLE_MH_RP2040
+			sem_release(&sem_);
+#else
+			{
+				std::lock_guard<std::mutex> lg(mtx_);
+				signalled_ = true;
+			}
+
+			cv_.notify_one();
+#endif
+		}
+
+		/** Wait for a notification
+
+			@param	timeoutUs	The maximum time to wait in microseconds.
+
+			@return				false if the wait timed out.
+		*/
+		bool WaitFor(uint32_t timeoutUs)
+		{
+#ifdef ENABLE_MH_RP2040
+			return sem_acquire_timeout_us(&sem_, timeoutUs);
+#else
+			std::unique_lock<std::mutex> lk(mtx_);
+
+			if (cv_.wait_for(lk, std::chrono::microseconds(timeoutUs), [this] { return signalled_; }) == false)
+			{
+				return false;
+			}
+
+			signalled_ = false;
+			return true;
+#endif
+		}
+	};
+
+	/** A std::atomic_flag spin lock
+
+		Spins on a relaxed test before retrying the exchange so waiters don't
+		bounce the cache line. Only suitable for very short critical sections,
+		for example pushing or popping a pool resource.
+	*/
+	class MH_SpinLock
+	{
+	private:
+		std::atomic_flag flag_{};
+	public:
+		void lock()
+		{
+			while (flag_.test_and_set(std::memory_order_acquire) == true)
+			{
+				while (flag_.test(std::memory_order_relaxed) == true)
+				{
+					MH_Pause();
+				}
+			}
+		}
+
+		bool try_lock()
+		{
+			return flag_.test_and_set(std::memory_order_acquire) == false;
+		}
+
+		void unlock()
+		{
+			flag_.clear(std::memory_order_release);
+		}
+	};
+
+#ifdef ENABLE_MH_RP2040
+	/** Try to take a hardware spin lock, the try lock counterpart of spin_lock_blocking
+
+		@param	lock	The spin lock.
+		@param	save	Receives the interrupt state to pass to spin_unlock on success.
+
+		@return			false if the lock is held, interrupts are left as they were.
+	*/
+	inline bool MH_SpinTryLock(spin_lock_t* lock, uint32_t& save)
+	{
+		auto interrupts = save_and_disable_interrupts();
+
+		// Reading a hardware spin lock claims it, a non zero value means it was free.
+		if (*lock != 0)
+		{
+			__mem_fence_acquire();
+			save = interrupts;
+			return true;
+		}
+
+		restore_interrupts(interrupts);
+		return false;
+	}
+
+	/** A RP2040 hardware spin lock
+
+		Claims one of the unused hardware spin locks, locking disables interrupts on
+		the calling core for the duration. Much cheaper than a pico mutex for the
+		handful of instructions the resource pools hold a lock for.
+
+		@remark	Interrupts are masked while it is held, nothing may allocate under it.
+	*/
+	class MH_HwSpinLock
+	{
+	private:
+		uint32_t num_;
+		spin_lock_t* lock_;
+		uint32_t save_{};
+	public:
+		MH_HwSpinLock()
+			: num_{ static_cast<uint32_t>(spin_lock_claim_unused(true)) }
+			, lock_{ spin_lock_instance(num_) }
+		{
+
+		}
+
+		~MH_HwSpinLock()
+		{
+			spin_lock_unclaim(num_);
+		}
+
+		MH_HwSpinLock(const MH_HwSpinLock&) = delete;
+		MH_HwSpinLock& operator=(const MH_HwSpinLock&) = delete;
+
+		void lock()
+		{
+			save_ = spin_lock_blocking(lock_);
+		}
+
+		bool try_lock()
+		{
+			return MH_SpinTryLock(lock_, save_);
+		}
+
+		void unlock()
+		{
+			spin_unlock(lock_, save_);
+		}
+	};
+
+	/** A RP2040 critical section
+
+		Masks interrupts on the calling core and excludes the other core, data it
+		protects may be shared with interrupt handlers on either core. Like the SDK
+		critical_section_t it uses one of the striped hardware spin locks, which are
+		shared, so it doesn't use up a claimed lock but two critical sections must
+		never be nested. It is built on the public spin lock functions rather than
+		critical_section_t, which has no try lock.
+
+		@remark	Interrupts are masked while it is held, nothing may allocate under it.
+	*/
+	class MH_CriticalSection
+	{
+	private:
+		spin_lock_t* lock_;
+		uint32_t save_{};
+	public:
+		MH_CriticalSection()
+			: lock_{ spin_lock_instance(next_striped_spin_lock_num()) }
+		{
+
+		}
+
+		MH_CriticalSection(const MH_CriticalSection&) = delete;
+		MH_CriticalSection& operator=(const MH_CriticalSection&) = delete;
+
+		void lock()
+		{
+			save_ = spin_lock_blocking(lock_);
+		}
+
+		bool try_lock()
+		{
+			return MH_SpinTryLock(lock_, save_);
+		}
+
+		void unlock()
+		{
+			spin_unlock(lock_, save_);
+		}
+	};
+#else
+	/** Hosted builds have no hardware spin locks or interrupts to mask, the RP2040
+		lock types fall back to MH_SpinLock so code naming them builds and can be
+		unit tested on both targets.
+	*/
+	using MH_HwSpinLock = MH_SpinLock;
+	using MH_CriticalSection = MH_SpinLock;
+#endif // ENABLE_MH_RP2040
 
+	/** Scoped lock for any of the lock types above */
+	template<class Lock = MH_Mutex>
 	class MH_LockGuard
 	{
 	private:
-		MH_Mutex& mtx_;
+		Lock& mtx_;
 	public:
-		explicit MH_LockGuard(MH_Mutex& mtx)
+		explicit MH_LockGuard(Lock& mtx)
 			: mtx_{ mtx }
 		{
 			mtx_.lock();
@@ -23,14 +23,99 @@ SOFTWARE.
 #ifndef MEEN_HW_MH_RESOURCEPOOL_H
 #define MEEN_HW_MH_RESOURCEPOOL_H
 
-#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <list>
+#include <utility>
+#include <vector>
 
 #include "meen_hw/MH_Mutex.h"
 
 namespace meen_hw
 {
+	/** A snapshot of resource pool statistics
+
+        @see    MH_ResourcePoolCounters
+	*/
+    struct MH_ResourcePoolStats
+    {
+        uint64_t acquires;          /**< Resources successfully handed out by GetResource. */
+        uint64_t releases;          /**< Resources returned to the pool. */
+        uint64_t lockFailures;      /**< GetResource calls that returned empty because the pool lock was contended. */
+        uint64_t emptyMisses;       /**< GetResource calls that returned empty because every resource was in use. */
+        uint64_t timeouts;          /**< AcquireResource calls that returned empty because the wait timed out. */
+        uint32_t outstanding;       /**< Resources currently held by callers. */
+        uint32_t highWater;         /**< The most resources held by callers at any one time. */
+    };
+
+	/** Resource pool statistics counters
+
+        Relaxed atomic counters that are cheap enough to be updated on every
+        acquire and release. The counters are independent of each other, a
+        snapshot taken while the pool is in use may be momentarily inconsistent.
+	*/
+    class MH_ResourcePoolCounters final
+    {
+    private:
+        alignas(64) std::atomic<uint64_t> acquires_{};
+        std::atomic<uint64_t> releases_{};
+        std::atomic<uint64_t> lockFailures_{};
+        std::atomic<uint64_t> emptyMisses_{};
+        std::atomic<uint64_t> timeouts_{};
+        std::atomic<uint32_t> outstanding_{};
+        std::atomic<uint32_t> highWater_{};
+
+    public:
+        void OnAcquire()
+        {
+            acquires_.fetch_add(1, std::memory_order_relaxed);
+            auto outstanding = outstanding_.fetch_add(1, std::memory_order_relaxed) + 1;
+            auto highWater = highWater_.load(std::memory_order_relaxed);
+
+            while (outstanding > highWater && highWater_.compare_exchange_weak(highWater, outstanding, std::memory_order_relaxed) == false);
+        }
+
+        void OnRelease()
+        {
+            releases_.fetch_add(1, std::memory_order_relaxed);
+            outstanding_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void OnLockFailure()
+        {
+            lockFailures_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void OnEmpty()
+        {
+            emptyMisses_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void OnTimeout()
+        {
+            timeouts_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        MH_ResourcePoolStats Snapshot() const
+        {
+            return
+            {
+                acquires_.load(std::memory_order_relaxed),
+                releases_.load(std::memory_order_relaxed),
+                lockFailures_.load(std::memory_order_relaxed),
+                emptyMisses_.load(std::memory_order_relaxed),
+                timeouts_.load(std::memory_order_relaxed),
+                outstanding_.load(std::memory_order_relaxed),
+                highWater_.load(std::memory_order_relaxed)
+            };
+        }
+    };
+
 	/** A basic resource pool.
 
 	    The resource pool is empty upon construction and can be
@@ -42,30 +127,176 @@ namespace meen_hw
         A custom deleter can be attached to the resource pool to custom
         destruct resources if required otherwise std::default_delete
         will be used.
+
+        The lock type L guards the shared list. MH_Mutex suits most hosts,
+        MH_SpinLock, MH_HwSpinLock or MH_CriticalSection hold the lock for
+        far fewer instructions, the latter two are the RP2040 native locks.
+        Those two mask interrupts while held, so nothing may allocate under
+        them: malloc can block on the pico malloc mutex. The list nodes are
+        allocated and freed outside the lock and only spliced in and out
+        under it, the magazines allocate under the lock but are not
+        available on the RP2040. Only use them with other containers that
+        never allocate while locked.
+
+        An optional per-thread magazine can be enabled at construction. Each
+        thread then keeps a small stack of resources of its own and exchanges
+        them with the shared pool in batches, so the shared mutex and list are
+        only touched about once every magazineSize / 2 operations. A GetResource
+        miss or a thread entering AcquireResource bumps the pool epoch, every
+        magazine returns its resources to the pool on its thread's next pool
+        operation once it sees the new epoch.
 	*/
-    template<class T, class D = std::default_delete<T>>
+    template<class T, class D = std::default_delete<T>, class L = MH_Mutex>
 	class MH_ResourcePool final
 	{
     private:
-        /** Resource pool mutex
-        
-            A resource can be returned to the resource pool from any thread. This is the mutex
-            used for mutual exclusion between that thread and the thread that this resource pool
-            uses for resource access.
-        
-            @remark     marked as mutable so GetResource can remain const
+        /** Resource pool shared state
+
+            The resource list, the mutex that guards it, the pool statistics and the
+            release notifications in a single allocation. It is shared with the deleter
+            of every resource handed out, so returning a resource only has to lock one
+            weak pointer to find out if the pool is still alive.
         */
-        mutable std::shared_ptr<MH_Mutex> resourceMutex_;
+        struct Shared
+        {
+            /** Resource pool mutex
 
-        /** Resource pool
-        
-            A pool of resources.
+                A resource can be returned to the resource pool from any thread. This is the mutex
+                used for mutual exclusion between that thread and the thread that this resource pool
+                uses for resource access.
+            */
+            L mutex;
+
+            /** Resource pool
 
-            @remark     A resource is automatically returned to the resource pool when it is destructed.
+                A pool of resources.
+
+                @remark     A resource is automatically returned to the resource pool when it is destructed.
+            */
+            std::list<std::unique_ptr<T, D>> resources;
+
+            MH_ResourcePoolCounters counters;
+            MH_Event released;
+            std::atomic<uint32_t> waiters{};
+
+            /** Bumped to ask every magazine to return its resources to the pool */
+            std::atomic<uint32_t> epoch{};
+
+            std::function<void()> onRelease;
+            uint32_t magazineSize{};
+        };
+
+        /** Resource pool shared state
 
             @remark     Marked as mutable so GetResource can remain const.
         */
-        mutable std::shared_ptr<std::list<std::unique_ptr<T, D>>> resourcePool_;
+        mutable std::shared_ptr<Shared> shared_;
+
+#ifndef ENABLE_MH_RP2040
+        /** A per-thread resource magazine
+
+            A small stack of resources owned by one thread for one resource pool. It
+            only holds a weak pointer to the pool so a thread that outlives the pool
+            deletes its cached resources instead of returning them.
+        */
+        struct Magazine
+        {
+            const Shared* owner{};
+            uint32_t epoch{};
+            std::weak_ptr<Shared> shared;
+            std::vector<std::unique_ptr<T, D>> resources;
+
+            Magazine() = default;
+            Magazine(Magazine&&) = default;
+            Magazine& operator=(Magazine&&) = delete;
+
+            ~Magazine()
+            {
+                Flush(resources.size());
+            }
+
+            /** Return the newest resources to the pool in one lock, or delete them when the pool no longer exists
+
+                @param  count   The number of resources to remove from the magazine.
+            */
+            void Flush(size_t count)
+            {
+                auto first = resources.end() - count;
+
+                if (auto pool = shared.lock())
+                {
+                    {
+                        MH_LockGuard lg(pool->mutex);
+                        std::move(first, resources.end(), std::back_inserter(pool->resources));
+                    }
+
+                    if (pool->waiters.load() > 0)
+                    {
+                        pool->released.Notify();
+                    }
+
+                    // The resources are only available to other threads from here on.
+                    if (count > 0 && pool->onRelease)
+                    {
+                        pool->onRelease();
+                    }
+                }
+
+                resources.erase(first, resources.end());
+            }
+        };
+
+        /** The calling thread's magazine for a resource pool
+
+            Magazines live in thread local storage and are flushed back to their pool when
+            the thread exits or the pool epoch changes. A slot whose pool has been destructed
+            is reused.
+
+            @param  shared          The pool shared state, it identifies the pool.
+
+            @return                 The magazine, only valid until the next call on this thread.
+        */
+        static Magazine& LocalMagazine(const std::shared_ptr<Shared>& shared)
+        {
+            static thread_local std::vector<Magazine> magazines;
+            Magazine* unused = nullptr;
+            auto epoch = shared->epoch.load(std::memory_order_relaxed);
+
+            for (auto& magazine : magazines)
+            {
+                if (magazine.shared.expired() == true)
+                {
+                    unused = &magazine;
+                }
+                else if (magazine.owner == shared.get())
+                {
+                    // Another thread is short of resources, give this thread's back.
+                    if (magazine.epoch != epoch)
+                    {
+                        magazine.epoch = epoch;
+                        magazine.Flush(magazine.resources.size());
+                    }
+
+                    return magazine;
+                }
+            }
+
+            if (unused == nullptr)
+            {
+                unused = &magazines.emplace_back();
+            }
+            else
+            {
+                unused->Flush(unused->resources.size());
+            }
+
+            unused->owner = shared.get();
+            unused->epoch = epoch;
+            unused->shared = shared;
+            unused->resources.reserve(shared->magazineSize);
+            return *unused;
+        }
+#endif // ENABLE_MH_RP2040
 
         /** Custom resource deleter
         
@@ -75,27 +306,15 @@ namespace meen_hw
         class ResourceDeleter
         {
         private:
-            /** resourcePool_
+            /** shared_
             
-                A weak pointer to MH_ResourcePool::resourcePool that can be used to check
+                A weak pointer to MH_ResourcePool::shared_ that can be used to check
                 if the resource pool is still alive. When it is alive the destructed frame will
-                be returned to it, otherwise it will be deleted.
+                be returned to it under its mutex and counted, otherwise it will be deleted.
 
-                @see    MH_ResourcePool::resourcePool_
+                @see    MH_ResourcePool::shared_
             */
-            std::weak_ptr<std::list<std::unique_ptr<T, D>>> resourcePool_;
-            
-            /** rsourceMutex_
-            
-                A weak pointer to  MH_ResourcePool::resourceMutex that can be used
-                to check if the resource mutex is still alive. When it is alive it will be
-                used to ensure mutual exculsion between the thread that this deleter was
-                invoked from and the thread on which this resource pool is running,
-                otherwise a warning message will be logged.
-
-                @see    MH_ResourcePool::resourceMutex_
-            */
-            std::weak_ptr<MH_Mutex> resourceMutex_;
+            std::weak_ptr<Shared> shared_;
 
             /** Resource deleter
             
@@ -113,14 +332,12 @@ namespace meen_hw
 
             /** Initialisation contstructor
 
-                A deleter with the specified resource pool and resource mutex.
+                A deleter with the specified resource pool.
 
-                @param      resourcePool       The resource pool that desructed resources will be returned to.
-                @param      resourceMutex      The resource pool mutex that will be used for mutual exclusion.
+                @param      shared      The resource pool shared state that desructed resources will be returned to.
             */
-            ResourceDeleter(const std::shared_ptr<std::list<std::unique_ptr<T, D>>>& resourcePool, const std::shared_ptr<MH_Mutex>& resourceMutex)
-                : resourcePool_(resourcePool)
-                , resourceMutex_{resourceMutex}
+            explicit ResourceDeleter(const std::shared_ptr<Shared>& shared)
+                : shared_(shared)
             {
 
             }
@@ -133,19 +350,50 @@ namespace meen_hw
             */
             void operator()(T* resource)
             {
-                if(auto resourcePool = resourcePool_.lock())
+                if(auto pool = shared_.lock())
                 {
-                    auto resourceMutex = resourceMutex_.lock();
-                    
-                    if(resourceMutex)
+                    pool->counters.OnRelease();
+
+#ifndef ENABLE_MH_RP2040
+                    // A thread blocked in AcquireResource can't see the magazines, so go straight to the pool while one is waiting.
+                    if(pool->magazineSize > 0 && pool->waiters.load() == 0)
                     {
-                        MH_LockGuard lg(*resourceMutex);
-                        resourcePool->emplace_back(std::unique_ptr<T, D>{resource});
+                        auto& magazine = LocalMagazine(pool);
+
+                        if(magazine.resources.size() >= pool->magazineSize)
+                        {
+                            magazine.Flush(magazine.resources.size() - pool->magazineSize / 2);
+                        }
+
+                        magazine.resources.emplace_back(resource);
+
+                        // A waiter that registered since the check above can't see the magazine, hand it all back.
+                        if(pool->waiters.load() > 0)
+                        {
+                            magazine.Flush(magazine.resources.size());
+                        }
                     }
                     else
+#endif
                     {
-                        assert(resourceMutex != nullptr);
-                        resourcePool->emplace_back(std::unique_ptr<T, D>{resource});
+                        // Allocate the list node before taking the lock, the lock may have interrupts masked.
+                        std::list<std::unique_ptr<T, D>> node;
+                        node.emplace_back(resource);
+                        {
+                            MH_LockGuard lg(pool->mutex);
+                            pool->resources.splice(pool->resources.end(), node);
+                        }
+
+                        // Only pay for the event when a thread is blocked in AcquireResource.
+                        if(pool->waiters.load() > 0)
+                        {
+                            pool->released.Notify();
+                        }
+
+                        if(pool->onRelease)
+                        {
+                            pool->onRelease();
+                        }
                     }
                 }
                 else
@@ -168,13 +416,23 @@ namespace meen_hw
 
             A very basic resource pool.
 
+            @param      magazineSize    The number of resources each thread may cache locally, 0 disables the magazines.
+
             @remark     The resource pool will be empty upon construction, call AddResource to populate
                         the resource pool.
+
+            @remark     Resources cached in one thread's magazine are not available to other threads until
+                        that thread next uses the pool after a miss elsewhere, keep magazineSize small compared
+                        to the number of resources in the pool. Magazines are not supported on the RP2040 and
+                        magazineSize is ignored there.
+
+            @remark     Resources still cached in a thread's magazine when the pool is destructed are deleted
+                        when that thread exits, or sooner if the thread reuses the magazine for another pool.
         */
-        explicit MH_ResourcePool()
+        explicit MH_ResourcePool(uint32_t magazineSize = 0)
         {
-            resourceMutex_ = std::make_shared<MH_Mutex>();
-            resourcePool_ = std::make_shared<std::list<std::unique_ptr<T, D>>>();
+            shared_ = std::make_shared<Shared>();
+            shared_->magazineSize = magazineSize;
         }
 
         /** Populate the resource pool
@@ -186,8 +444,10 @@ namespace meen_hw
         */
         void AddResource(T* resource)
         {
-            MH_LockGuard lg(*resourceMutex_);
-            resourcePool_->emplace_back(std::unique_ptr<T, D>{resource});
+            std::list<std::unique_ptr<T, D>> node;
+            node.emplace_back(resource);
+            MH_LockGuard lg(shared_->mutex);
+            shared_->resources.splice(shared_->resources.end(), node);
         }
 
         /** Destructor
@@ -199,28 +459,977 @@ namespace meen_hw
         /** Get a resource from the resource pool
 
             @return         A valid resource or empty if a resource is unavailable.
+
+            @remark         With magazines enabled the calling thread's magazine is tried first,
+                            the shared pool is only locked when the magazine is empty.
         */
         ResourcePtr GetResource() const
         {
             std::unique_ptr<T, D> resource;
 
+#ifndef ENABLE_MH_RP2040
+            if (shared_->magazineSize > 0)
+            {
+                auto& magazine = LocalMagazine(shared_);
+
+                if (magazine.resources.empty() == true)
+                {
+                    // Refill half a magazine under one lock so the next few acquires stay thread local.
+                    if (shared_->mutex.try_lock() == false)
+                    {
+                        shared_->counters.OnLockFailure();
+                        return ResourcePtr{nullptr, ResourceDeleter{shared_}};
+                    }
+
+                    // Only take one while a thread waits in AcquireResource, a refill would hide the rest from it.
+                    auto batch = shared_->waiters.load() > 0 ? 1 : std::max<uint32_t>(shared_->magazineSize / 2, 1);
+                    auto count = std::min<size_t>(shared_->resources.size(), batch);
+
+                    for (; count > 0; count--)
+                    {
+                        magazine.resources.emplace_back(std::move(shared_->resources.back()));
+                        shared_->resources.pop_back();
+                    }
+
+                    shared_->mutex.unlock();
+                }
+
+                if (magazine.resources.empty() == false)
+                {
+                    resource = std::move(magazine.resources.back());
+                    magazine.resources.pop_back();
+                }
+
+                if (resource != nullptr)
+                {
+                    shared_->counters.OnAcquire();
+                }
+                else
+                {
+                    // Free resources may be cached by other threads, ask for them back.
+                    shared_->epoch.fetch_add(1, std::memory_order_relaxed);
+                    shared_->counters.OnEmpty();
+                }
+
+                return ResourcePtr{resource.release(), ResourceDeleter{shared_}};
+            }
+#endif // ENABLE_MH_RP2040
+
             // This method is called from ServiceInterrupts so we don't 
             // want to block waiting for this mutex as we could stall the cpu,
             // if we don't get it, this resource will be dropped (host is too
             // slow, the machine clock resolution is too high or the function
             // call spuriously failed).
-            if (resourceMutex_->try_lock() == true)
+            if (shared_->mutex.try_lock() == true)
+            {
+                // Unlink the node under the lock and free it after, the lock may have interrupts masked.
+                std::list<std::unique_ptr<T, D>> node;
+
+                if (shared_->resources.empty() == false)
+                {
+                    node.splice(node.end(), shared_->resources, std::prev(shared_->resources.end()));
+                }
+
+                shared_->mutex.unlock();
+
+                if (node.empty() == false)
+                {
+                    resource = std::move(node.back());
+                }
+
+                resource != nullptr ? shared_->counters.OnAcquire() : shared_->counters.OnEmpty();
+            }
+            else
+            {
+                shared_->counters.OnLockFailure();
+            }
+
+            return ResourcePtr{resource.release(), ResourceDeleter{shared_}};
+        }
+
+        /** Wait for a resource from the resource pool
+
+            Unlike GetResource this blocks on the pool mutex and then sleeps until
+            a resource is returned to the pool or the timeout expires. It is meant for
+            consumers that are not time critical, GetResource should still be used
+            from ServiceInterrupts.
+
+            It only takes resources from the shared pool. Entering it bumps the pool epoch so the
+            magazines, starting with the calling thread's, return their resources on their next
+            operation. While a thread is waiting, released resources bypass the magazines.
+
+            @remark     A resource released into a magazine just as the waiter registers stays
+                        there until that thread's next pool operation.
+
+            @param  timeout     The maximum time to wait.
+
+            @return             A valid resource or empty if the timeout expired.
+        */
+        ResourcePtr AcquireResource(std::chrono::microseconds timeout) const
+        {
+            std::unique_ptr<T, D> resource;
+            std::list<std::unique_ptr<T, D>> node;
+            bool passOn = false;
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+
+            // Register as a waiter before checking the pool, a release that follows the check is then sure to notify.
+            shared_->waiters.fetch_add(1);
+#ifndef ENABLE_MH_RP2040
+            if (shared_->magazineSize > 0)
+            {
+                shared_->epoch.fetch_add(1, std::memory_order_relaxed);
+                LocalMagazine(shared_);
+            }
+#endif // ENABLE_MH_RP2040
+
+            while (true)
+            {
+                {
+                    MH_LockGuard lg(shared_->mutex);
+
+                    if (shared_->resources.empty() == false)
+                    {
+                        node.splice(node.end(), shared_->resources, std::prev(shared_->resources.end()));
+                        passOn = shared_->resources.empty() == false;
+                        break;
+                    }
+                }
+
+                auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+
+                if (remaining.count() <= 0 || shared_->released.WaitFor(static_cast<uint32_t>(std::min<int64_t>(remaining.count(), UINT32_MAX))) == false)
+                {
+                    break;
+                }
+            }
+
+            shared_->waiters.fetch_sub(1);
+
+            // Notifications don't accumulate, pass one on in case another waiter missed it.
+            // Notified outside the lock, an RP2040 semaphore takes a spin lock that mustn't nest.
+            if (passOn == true)
+            {
+                shared_->released.Notify();
+            }
+
+            if (node.empty() == false)
+            {
+                resource = std::move(node.back());
+            }
+
+            resource != nullptr ? shared_->counters.OnAcquire() : shared_->counters.OnTimeout();
+            return ResourcePtr{resource.release(), ResourceDeleter{shared_}};
+        }
+
+        /** Release notification
+
+            Sets a function that is called every time resources are returned to the pool,
+            after they are available to GetResource on any thread. It is called on the thread
+            that returned them, so it must be thread safe and cheap, for example signalling an
+            eventfd or waking an event loop.
+
+            With magazines a released resource is first cached for the releasing thread only,
+            the function is called once per magazine flush instead, when the cached resources
+            reach the pool. That may be much later, for example when the thread exits.
+
+            @param  onRelease   The function to call, or empty to remove it.
+
+            @remark             Must be set before any resources are handed out.
+        */
+        void SetReleaseCallback(std::function<void()> onRelease)
+        {
+            shared_->onRelease = std::move(onRelease);
+        }
+
+        /** Resource pool statistics
+
+            @return         A snapshot of the counters since the pool was constructed.
+        */
+        MH_ResourcePoolStats Stats() const
+        {
+            return shared_->counters.Snapshot();
+        }
+    };
+
+	/** A lock-free stack of node indices.
+
+        A Treiber stack over an external array of nodes, each node must have a
+        `std::atomic<uint32_t> next` member. The head packs a 32 bit tag alongside
+        the top index, the tag is bumped on every update to protect against ABA.
+        Popping the most recently pushed index first keeps recently used nodes
+        warm in cache.
+	*/
+    class MH_LockFreeIndexStack final
+    {
+    private:
+        /** The tag (upper 32 bits) and top node index (lower 32 bits) */
+        alignas(64) std::atomic<uint64_t> head_{ Nil };
+
+    public:
+        /** The index of an empty stack */
+        static constexpr uint32_t Nil = UINT32_MAX;
+
+        /** Push a node index
+
+            @param  nodes       The nodes that the indices refer to.
+            @param  index       The node to push, it must not already be on the stack.
+        */
+        template<class Node>
+        void Push(Node* nodes, uint32_t index)
+        {
+            auto head = head_.load(std::memory_order_relaxed);
+            uint64_t next;
+
+            do
+            {
+                nodes[index].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+                next = ((head >> 32) + 1) << 32 | index;
+            }
+            while (head_.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed) == false);
+        }
+
+        /** Pop the most recently pushed node index
+
+            @param  nodes       The nodes that the indices refer to.
+            @param  index       Receives the popped node.
+
+            @return             false if the stack is empty.
+        */
+        template<class Node>
+        bool Pop(Node* nodes, uint32_t& index)
+        {
+            auto head = head_.load(std::memory_order_acquire);
+            uint64_t next;
+
+            do
+            {
+                index = static_cast<uint32_t>(head);
+
+                if (index == Nil)
+                {
+                    return false;
+                }
+
+                // May be stale if another thread popped this node first, the tag makes the exchange fail.
+                next = ((head >> 32) + 1) << 32 | nodes[index].next.load(std::memory_order_relaxed);
+            }
+            while (head_.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire) == false);
+
+            return true;
+        }
+    };
+
+	/** A lock-free resource pool.
+
+        Behaves like MH_ResourcePool except that GetResource and the return
+        of a resource to the pool never take a lock, so they never block and
+        GetResource only returns an empty resource when the pool really is empty.
+
+        The free resources are held in a MH_LockFreeIndexStack.
+
+        @remark     The capacity is fixed upon construction.
+
+        @remark     The stack head is a 64 bit atomic, which is only lock-free on
+                    hosts that provide a native 64 bit compare and swap.
+	*/
+    template<class T, class D = std::default_delete<T>>
+    class MH_LockFreeResourcePool final
+    {
+    private:
+        /** Lock-free free list
+
+            The resource nodes and the stack of free node indices. Shared between
+            the pool and its outstanding resources so a resource can tell if the
+            pool is still alive when it is returned.
+        */
+        class FreeList
+        {
+        private:
+            /** A resource and the index of the node below it on the free stack */
+            struct Node
+            {
+                T* resource{};
+                std::atomic<uint32_t> next{};
+            };
+
+            std::unique_ptr<Node[]> nodes_;
+            uint32_t capacity_;
+            uint32_t count_{};
+            MH_LockFreeIndexStack stack_;
+
+        public:
+            /** The pool statistics, shared with the deleter through the free list */
+            MH_ResourcePoolCounters counters;
+
+            explicit FreeList(uint32_t capacity)
+                : nodes_{ std::make_unique<Node[]>(capacity) }
+                , capacity_{ capacity }
             {
-                if (resourcePool_->empty() == false)
+
+            }
+
+            /** Delete the resources that are still in the pool */
+            ~FreeList()
+            {
+                uint32_t index;
+
+                while (Pop(index) == true)
+                {
+                    D{}(nodes_[index].resource);
+                }
+            }
+
+            bool Add(T* resource)
+            {
+                if (count_ == capacity_)
                 {
-                    resource = std::move(resourcePool_->back());
-                    resourcePool_->pop_back();
+                    return false;
                 }
 
-                resourceMutex_->unlock();
+                nodes_[count_].resource = resource;
+                Push(count_++);
+                return true;
+            }
+
+            T* Resource(uint32_t index) const
+            {
+                return nodes_[index].resource;
+            }
+
+            void Push(uint32_t index)
+            {
+                stack_.Push(nodes_.get(), index);
             }
 
-            return ResourcePtr{resource.release(), ResourceDeleter{resourcePool_, resourceMutex_}};
+            bool Pop(uint32_t& index)
+            {
+                return stack_.Pop(nodes_.get(), index);
+            }
+        };
+
+        /** The resources and their free stack
+
+            @remark     Marked as mutable so GetResource can remain const.
+        */
+        mutable std::shared_ptr<FreeList> freeList_;
+
+        /** Custom resource deleter
+
+            Returns the resource to the pool by pushing its node back onto the
+            free stack, or deletes it when the pool no longer exists.
+        */
+        class ResourceDeleter
+        {
+        private:
+            std::weak_ptr<FreeList> freeList_;
+            uint32_t index_{};
+            D resourceDeleter_;
+
+        public:
+            ResourceDeleter() = default;
+
+            ResourceDeleter(const std::shared_ptr<FreeList>& freeList, uint32_t index)
+                : freeList_{ freeList }
+                , index_{ index }
+            {
+
+            }
+
+            void operator()(T* resource)
+            {
+                if (auto freeList = freeList_.lock())
+                {
+                    freeList->counters.OnRelease();
+                    freeList->Push(index_);
+                }
+                else
+                {
+                    resourceDeleter_(resource);
+                }
+            }
+        };
+
+    public:
+        /** Custom resource unique_ptr with custom deleter attached
+
+            @remark     When this resource is destructed it will be automatically returned to the resource pool.
+        */
+        using ResourcePtr = std::unique_ptr<T, MH_LockFreeResourcePool::ResourceDeleter>;
+
+        /** Constructor
+
+            @param      capacity    The maximum number of resources the pool can hold.
+
+            @remark     The resource pool will be empty upon construction, call AddResource to populate
+                        the resource pool.
+        */
+        explicit MH_LockFreeResourcePool(uint32_t capacity)
+            : freeList_{ std::make_shared<FreeList>(capacity) }
+        {
+
+        }
+
+        /** Populate the resource pool
+
+            Add an item to the resource pool.
+
+            @param  resource    The resource to be added.
+
+            @return             false if the pool is at capacity, the resource is not taken.
+
+            @remark             Must not be called concurrently with itself.
+        */
+        bool AddResource(T* resource)
+        {
+            return freeList_->Add(resource);
+        }
+
+        /** Get a resource from the resource pool
+
+            @return         A valid resource or empty if every resource is in use.
+        */
+        ResourcePtr GetResource() const
+        {
+            uint32_t index;
+
+            if (freeList_->Pop(index) == false)
+            {
+                freeList_->counters.OnEmpty();
+                return ResourcePtr{ nullptr, ResourceDeleter{} };
+            }
+
+            freeList_->counters.OnAcquire();
+            return ResourcePtr{ freeList_->Resource(index), ResourceDeleter{ freeList_, index } };
+        }
+
+        /** Resource pool statistics
+
+            @return         A snapshot of the counters since the pool was constructed,
+                            lockFailures is always 0.
+        */
+        MH_ResourcePoolStats Stats() const
+        {
+            return freeList_->counters.Snapshot();
+        }
+    };
+
+	/** A resource pool with compact, generation tagged handles.
+
+        Behaves like MH_LockFreeResourcePool except that GetResource returns a
+        Handle instead of a std::unique_ptr with a weak_ptr carrying deleter. A
+        handle is a pointer to the pool control block plus a slot index and
+        generation, releasing it costs one atomic liveness check and a reference
+        count decrement instead of locking weak pointers.
+
+        The index and generation can be copied out of a handle as a Token, a
+        non owning reference that Lookup resolves only while that use of the
+        slot is current, stale tokens resolve to nullptr.
+
+        @remark     Resources may outlive the pool, a resource released after the
+                    pool has been destructed is deleted with D.
+	*/
+    template<class T, class D = std::default_delete<T>>
+    class MH_HandleResourcePool final
+    {
+    private:
+        /** Pool control block
+
+            The resource slots and their free stack. Reference counted by the pool and
+            every outstanding handle, it is deleted with the last of them.
+        */
+        class ControlBlock
+        {
+        private:
+            /** A resource, the generation of its current use and the index of the slot below it on the free stack
+
+                The generation is bumped when the slot is handed out and again when it is returned,
+                so a token from an earlier use never matches.
+            */
+            struct Slot
+            {
+                T* resource{};
+                std::atomic<uint32_t> next{};
+                std::atomic<uint32_t> generation{};
+            };
+
+            std::unique_ptr<Slot[]> slots_;
+            uint32_t capacity_;
+            uint32_t count_{};
+            MH_LockFreeIndexStack stack_;
+            std::atomic<uint32_t> references_{ 1 };
+            std::atomic<bool> alive_{ true };
+
+            /** Delete the resources that are on the free stack */
+            void DeleteFree()
+            {
+                uint32_t index;
+
+                while (stack_.Pop(slots_.get(), index) == true)
+                {
+                    D{}(slots_[index].resource);
+                }
+            }
+
+        public:
+            /** The pool statistics */
+            MH_ResourcePoolCounters counters;
+
+            explicit ControlBlock(uint32_t capacity)
+                : slots_{ std::make_unique<Slot[]>(capacity) }
+                , capacity_{ capacity }
+            {
+
+            }
+
+            /** Delete the resources that were returned while the pool was closing */
+            ~ControlBlock()
+            {
+                DeleteFree();
+            }
+
+            bool Add(T* resource)
+            {
+                if (count_ == capacity_)
+                {
+                    return false;
+                }
+
+                slots_[count_].resource = resource;
+                stack_.Push(slots_.get(), count_++);
+                return true;
+            }
+
+            /** Pop a free slot and start a new generation for it
+
+                @return     false if every slot is in use.
+            */
+            bool Acquire(uint32_t& index, uint32_t& generation)
+            {
+                if (stack_.Pop(slots_.get(), index) == false)
+                {
+                    return false;
+                }
+
+                references_.fetch_add(1, std::memory_order_relaxed);
+                generation = slots_[index].generation.fetch_add(1, std::memory_order_release) + 1;
+                return true;
+            }
+
+            /** Return a slot to the free stack, or delete its resource if the pool is gone */
+            void Release(uint32_t index)
+            {
+                if (alive_.load(std::memory_order_acquire) == true)
+                {
+                    counters.OnRelease();
+                    slots_[index].generation.fetch_add(1, std::memory_order_release);
+                    stack_.Push(slots_.get(), index);
+                }
+                else
+                {
+                    D{}(slots_[index].resource);
+                }
+
+                Unreference();
+            }
+
+            /** Delete the free resources, resources released from now on are deleted */
+            void Close()
+            {
+                alive_.store(false, std::memory_order_release);
+                DeleteFree();
+            }
+
+            void Unreference()
+            {
+                if (references_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+
+            T* Resource(uint32_t index) const
+            {
+                return slots_[index].resource;
+            }
+
+            /** The resource in a slot if generation is its current use, otherwise nullptr */
+            T* Lookup(uint32_t index, uint32_t generation) const
+            {
+                if (index >= capacity_ || slots_[index].generation.load(std::memory_order_acquire) != generation)
+                {
+                    return nullptr;
+                }
+
+                return slots_[index].resource;
+            }
+        };
+
+        /** The resources and their free stack, shared with the outstanding handles */
+        ControlBlock* block_;
+
+    public:
+        /** A non owning reference to one use of a pooled resource
+
+            Cheap to copy and to pass between threads, for example through a MH_RingBuffer,
+            while the handle that owns the resource stays put.
+
+            @see    Lookup
+        */
+        struct Token
+        {
+            uint32_t index;
+            uint32_t generation;
+        };
+
+        /** A handle to a pooled resource
+
+            A move only owner of one resource, the resource is returned to the pool when
+            the handle is destructed, reset or assigned to. The generation identifies this
+            use of the slot.
+        */
+        class Handle
+        {
+        private:
+            ControlBlock* block_{};
+            uint32_t index_{};
+            uint32_t generation_{};
+
+            friend class MH_HandleResourcePool;
+
+            Handle(ControlBlock* block, uint32_t index, uint32_t generation)
+                : block_{ block }
+                , index_{ index }
+                , generation_{ generation }
+            {
+
+            }
+
+        public:
+            /** Default constructor
+
+                An empty handle.
+            */
+            Handle() = default;
+
+            Handle(std::nullptr_t)
+            {
+
+            }
+
+            Handle(Handle&& other) noexcept
+                : block_{ std::exchange(other.block_, nullptr) }
+                , index_{ other.index_ }
+                , generation_{ other.generation_ }
+            {
+
+            }
+
+            Handle& operator=(Handle&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    reset();
+                    block_ = std::exchange(other.block_, nullptr);
+                    index_ = other.index_;
+                    generation_ = other.generation_;
+                }
+
+                return *this;
+            }
+
+            Handle(const Handle&) = delete;
+            Handle& operator=(const Handle&) = delete;
+
+            ~Handle()
+            {
+                reset();
+            }
+
+            /** Return the resource to the pool, the handle is empty afterwards */
+            void reset()
+            {
+                if (block_ != nullptr)
+                {
+                    std::exchange(block_, nullptr)->Release(index_);
+                }
+            }
+
+            T* get() const
+            {
+                return block_ != nullptr ? block_->Resource(index_) : nullptr;
+            }
+
+            T& operator*() const
+            {
+                return *get();
+            }
+
+            T* operator->() const
+            {
+                return get();
+            }
+
+            explicit operator bool() const
+            {
+                return block_ != nullptr;
+            }
+
+            friend bool operator==(const Handle& handle, std::nullptr_t)
+            {
+                return handle.block_ == nullptr;
+            }
+
+            /** The slot the resource occupies in the pool */
+            uint32_t Index() const
+            {
+                return index_;
+            }
+
+            /** Identifies this use of the slot, it changes every time the slot is handed out */
+            uint32_t Generation() const
+            {
+                return generation_;
+            }
+
+            /** A token for this use of the slot, only meaningful while the handle is not empty */
+            Token GetToken() const
+            {
+                return { index_, generation_ };
+            }
+        };
+
+        /** The type returned by GetResource
+
+            @remark     When this resource is destructed it will be automatically returned to the resource pool.
+        */
+        using ResourcePtr = Handle;
+
+        /** Constructor
+
+            @param      capacity    The maximum number of resources the pool can hold.
+
+            @remark     The resource pool will be empty upon construction, call AddResource to populate
+                        the resource pool.
+        */
+        explicit MH_HandleResourcePool(uint32_t capacity)
+            : block_{ new ControlBlock(capacity) }
+        {
+
+        }
+
+        MH_HandleResourcePool(const MH_HandleResourcePool&) = delete;
+        MH_HandleResourcePool& operator=(const MH_HandleResourcePool&) = delete;
+
+        /** Destructor
+
+            Delete the resources in the pool, outstanding resources are deleted when they are released.
+        */
+        ~MH_HandleResourcePool()
+        {
+            block_->Close();
+            block_->Unreference();
+        }
+
+        /** Populate the resource pool
+
+            Add an item to the resource pool.
+
+            @param  resource    The resource to be added.
+
+            @return             false if the pool is at capacity, the resource is not taken.
+
+            @remark             Must not be called concurrently with itself.
+        */
+        bool AddResource(T* resource)
+        {
+            return block_->Add(resource);
+        }
+
+        /** Get a resource from the resource pool
+
+            @return         A valid handle or empty if every resource is in use.
+        */
+        ResourcePtr GetResource() const
+        {
+            uint32_t index;
+            uint32_t generation;
+
+            if (block_->Acquire(index, generation) == false)
+            {
+                block_->counters.OnEmpty();
+                return ResourcePtr{};
+            }
+
+            block_->counters.OnAcquire();
+            return ResourcePtr{ block_, index, generation };
+        }
+
+        /** Resolve a token
+
+            @param  token   A token taken from a handle to a resource of this pool.
+
+            @return         The resource while the handle the token was taken from still holds it,
+                            nullptr once it has been returned to the pool, whether or not the slot
+                            has been handed out again.
+
+            @remark         The token does not own the resource, the caller must make sure the
+                            handle is not released while the returned pointer is in use.
+        */
+        T* Lookup(Token token) const
+        {
+            return block_->Lookup(token.index, token.generation);
+        }
+
+        /** Resource pool statistics
+
+            @return         A snapshot of the counters since the pool was constructed,
+                            lockFailures is always 0.
+        */
+        MH_ResourcePoolStats Stats() const
+        {
+            return block_->counters.Snapshot();
+        }
+    };
+
+	/** A fixed capacity, allocation free resource pool.
+
+        The pool owns Capacity resources which are constructed in place in one
+        contiguous array of cache line aligned slots, no two resources share a
+        cache line. The only heap allocation is the slot array upon construction,
+        getting and returning resources never allocates.
+
+        Free slots are held in a MH_LockFreeIndexStack, so the most recently
+        returned slot is the next one handed out while it is still warm in cache.
+
+        @remark     Resources may outlive the pool, the slot array is released once
+                    the pool and every outstanding resource are gone.
+	*/
+    template<class T, uint32_t Capacity>
+    class MH_FixedResourcePool final
+    {
+    private:
+        static_assert(Capacity > 0 && Capacity < MH_LockFreeIndexStack::Nil);
+
+        /** A resource and the index of the slot below it on the free stack */
+        struct alignas(64) Slot
+        {
+            T resource;
+            std::atomic<uint32_t> next{};
+        };
+
+        /** The contiguous slot array and its free stack */
+        struct Slots
+        {
+            Slot slots[Capacity];
+            MH_LockFreeIndexStack stack;
+            MH_ResourcePoolCounters counters;
+
+            template<class... Args>
+            explicit Slots(const Args&... args)
+                : slots{}
+            {
+                for (uint32_t i = 0; i < Capacity; i++)
+                {
+                    if constexpr (sizeof...(Args) > 0)
+                    {
+                        slots[i].resource = T(args...);
+                    }
+
+                    // Push in reverse so slot 0 is handed out first.
+                    stack.Push(slots, Capacity - 1 - i);
+                }
+            }
+        };
+
+        /** The slot storage, shared with every outstanding resource
+
+            @remark     Marked as mutable so GetResource can remain const.
+        */
+        mutable std::shared_ptr<Slots> slots_;
+
+        /** Custom resource deleter
+
+            Pushes the resource's slot back onto the free stack, the slots are
+            kept alive for as long as a resource is outstanding.
+        */
+        class ResourceDeleter
+        {
+        private:
+            std::shared_ptr<Slots> slots_;
+            uint32_t index_{};
+
+        public:
+            ResourceDeleter() = default;
+
+            ResourceDeleter(const std::shared_ptr<Slots>& slots, uint32_t index)
+                : slots_{ slots }
+                , index_{ index }
+            {
+
+            }
+
+            void operator()(T*)
+            {
+                // Count the release first so the high water mark never sees this resource twice.
+                slots_->counters.OnRelease();
+                slots_->stack.Push(slots_->slots, index_);
+                slots_.reset();
+            }
+        };
+
+    public:
+        /** Custom resource unique_ptr with custom deleter attached
+
+            @remark     When this resource is destructed it will be automatically returned to the resource pool.
+        */
+        using ResourcePtr = std::unique_ptr<T, MH_FixedResourcePool::ResourceDeleter>;
+
+        /** Constructor
+
+            Constructs all Capacity resources.
+
+            @param  args        When present, each resource is constructed from a copy of args,
+                                otherwise resources are value initialised.
+        */
+        template<class... Args>
+        explicit MH_FixedResourcePool(const Args&... args)
+            : slots_{ std::make_shared<Slots>(args...) }
+        {
+
+        }
+
+        /** The number of resources owned by the pool */
+        static constexpr uint32_t Size()
+        {
+            return Capacity;
+        }
+
+        /** Get a resource from the resource pool
+
+            @return         A valid resource or empty if every resource is in use.
+        */
+        ResourcePtr GetResource() const
+        {
+            uint32_t index;
+
+            if (slots_->stack.Pop(slots_->slots, index) == false)
+            {
+                slots_->counters.OnEmpty();
+                return ResourcePtr{ nullptr, ResourceDeleter{} };
+            }
+
+            slots_->counters.OnAcquire();
+            return ResourcePtr{ &slots_->slots[index].resource, ResourceDeleter{ slots_, index } };
+        }
+
+        /** Resource pool statistics
+
+            @return         A snapshot of the counters since the pool was constructed,
+                            lockFailures is always 0.
+        */
+        MH_ResourcePoolStats Stats() const
+        {
+            return slots_->counters.Snapshot();
         }
     };
 } // namespace meen_hw
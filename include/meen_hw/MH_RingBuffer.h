@@ -0,0 +1,194 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEEN_HW_MH_RINGBUFFER_H
+#define MEEN_HW_MH_RINGBUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+namespace meen_hw
+{
+	/** A lock-free single producer, single consumer ring buffer.
+
+		Moves values from one thread to another without locking, for example
+		audio events from the thread calling WritePort to the audio thread, or
+		frame pointers from the emulation thread to the presenter. The head and
+		tail indices live on their own cache lines and each side keeps a cached
+		copy of the other side's index, so the shared lines are only read when
+		the cached copy says the ring is full or empty.
+
+		The indices are free running and only ever loaded and stored, never read
+		modify written, so the ring is lock-free on the RP2040 Cortex-M0+ cores
+		as well as on hosted targets.
+
+		@remark		Exactly one producer thread (or core) and one consumer thread (or core).
+
+		@code
+		MH_RingBuffer<uint8_t, 256> soundEvents;
+
+		// Cpu thread
+		soundEvents.Push(value);
+
+		// Audio thread
+		uint8_t events[32];
+		auto count = soundEvents.Pop(std::span(events));
+		@endcode
+	*/
+	template<class T, uint32_t N>
+	class MH_RingBuffer final
+	{
+		static_assert(N > 0 && (N & (N - 1)) == 0, "MH_RingBuffer capacity must be a power of two");
+
+	private:
+		static constexpr uint32_t mask_ = N - 1;
+
+		/** The next slot to write, stored by the producer */
+		alignas(64) std::atomic<uint32_t> head_{};
+
+		/** The producer's copy of tail_ */
+		uint32_t cachedTail_{};
+
+		/** The next slot to read, stored by the consumer */
+		alignas(64) std::atomic<uint32_t> tail_{};
+
+		/** The consumer's copy of head_ */
+		uint32_t cachedHead_{};
+
+		alignas(64) T items_[N]{};
+
+	public:
+		MH_RingBuffer() = default;
+		MH_RingBuffer(const MH_RingBuffer&) = delete;
+		MH_RingBuffer& operator=(const MH_RingBuffer&) = delete;
+
+		/** The number of values the ring can hold */
+		static constexpr uint32_t Capacity()
+		{
+			return N;
+		}
+
+		/** Push one value
+
+			@param	value	The value to push.
+
+			@return			false if the ring is full, the value is not pushed.
+
+			@remark			Producer only.
+		*/
+		bool Push(const T& value)
+		{
+			return Push(std::span<const T>(&value, 1)) == 1;
+		}
+
+		/** Push as many values as there is room for
+
+			The values are copied in at most two contiguous runs and published with
+			a single store.
+
+			@param	values	The values to push, in order.
+
+			@return			The number of values pushed from the front of values.
+
+			@remark			Producer only.
+		*/
+		uint32_t Push(std::span<const T> values)
+		{
+			auto head = head_.load(std::memory_order_relaxed);
+			auto count = static_cast<uint32_t>(std::min<size_t>(values.size(), N - (head - cachedTail_)));
+
+			if (count < values.size())
+			{
+				cachedTail_ = tail_.load(std::memory_order_acquire);
+				count = static_cast<uint32_t>(std::min<size_t>(values.size(), N - (head - cachedTail_)));
+			}
+
+			if (count == 0)
+			{
+				return 0;
+			}
+
+			auto first = std::min(count, N - (head & mask_));
+			std::copy_n(values.begin(), first, items_ + (head & mask_));
+			std::copy_n(values.begin() + first, count - first, items_);
+			head_.store(head + count, std::memory_order_release);
+			return count;
+		}
+
+		/** Pop one value
+
+			@param	value	Receives the oldest value.
+
+			@return			false if the ring is empty, value is unchanged.
+
+			@remark			Consumer only.
+		*/
+		bool Pop(T& value)
+		{
+			return Pop(std::span<T>(&value, 1)) == 1;
+		}
+
+		/** Pop as many values as are available
+
+			@param	values	Receives the oldest values, in order.
+
+			@return			The number of values written to the front of values.
+
+			@remark			Consumer only.
+		*/
+		uint32_t Pop(std::span<T> values)
+		{
+			auto tail = tail_.load(std::memory_order_relaxed);
+			auto count = static_cast<uint32_t>(std::min<size_t>(values.size(), cachedHead_ - tail));
+
+			if (count < values.size())
+			{
+				cachedHead_ = head_.load(std::memory_order_acquire);
+				count = static_cast<uint32_t>(std::min<size_t>(values.size(), cachedHead_ - tail));
+			}
+
+			if (count == 0)
+			{
+				return 0;
+			}
+
+			auto first = std::min(count, N - (tail & mask_));
+			std::copy_n(items_ + (tail & mask_), first, values.begin());
+			std::copy_n(items_, count - first, values.begin() + first);
+			tail_.store(tail + count, std::memory_order_release);
+			return count;
+		}
+
+		/** The number of values in the ring
+
+			@remark		Only a snapshot when called while the other side is active.
+		*/
+		uint32_t Size() const
+		{
+			return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+		}
+	};
+} // namespace meen_hw
+
+#endif // MEEN_HW_MH_RINGBUFFER_H
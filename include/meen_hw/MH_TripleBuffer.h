@@ -0,0 +1,142 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEEN_HW_MH_TRIPLEBUFFER_H
+#define MEEN_HW_MH_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace meen_hw
+{
+	/** A wait-free latest value exchange.
+
+		Hands buffers from a single producer to a single consumer where the
+		consumer only ever wants the newest completed buffer, for example
+		frames from the emulation thread to the presenter. There are three
+		buffers: the back buffer owned by the producer, the front buffer owned
+		by the consumer and a middle buffer that is exchanged between them.
+
+		Publish and Acquire are each a single atomic exchange, neither side
+		ever waits on the other. A published buffer that is superseded before
+		the consumer acquires it is handed straight back to the producer.
+
+		@remark		Exactly one producer thread and one consumer thread.
+
+		@code
+		// One 8bpp upright frame per buffer
+		MH_TripleBuffer<std::vector<uint8_t>> frames(224 * 256);
+
+		// Emulation thread
+		io->BlitVRAM(std::span(frames.Back()), 224, vram);
+		frames.Publish();
+
+		// Presenter thread
+		if (frames.Acquire() == true)
+		{
+			Present(frames.Front());
+		}
+		@endcode
+	*/
+	template<class T>
+	class MH_TripleBuffer final
+	{
+	private:
+		/** Set in middle_ when it holds a buffer the consumer has not yet seen */
+		static constexpr uint8_t fresh_ = 0x04;
+		static constexpr uint8_t indexMask_ = 0x03;
+
+		T buffers_[3];
+
+		/** The index of the middle buffer and the fresh flag */
+		alignas(64) std::atomic<uint8_t> middle_{ 1 };
+
+		/** The index of the producer's buffer, only accessed by the producer */
+		alignas(64) uint8_t back_{ 0 };
+
+		/** The index of the consumer's buffer, only accessed by the consumer */
+		alignas(64) uint8_t front_{ 2 };
+
+	public:
+		/** Constructor
+
+			@param	args	Each of the three buffers is constructed from args,
+							for example the size of a frame.
+		*/
+		template<class... Args>
+		explicit MH_TripleBuffer(const Args&... args)
+			: buffers_{ T(args...), T(args...), T(args...) }
+		{
+
+		}
+
+		MH_TripleBuffer(const MH_TripleBuffer&) = delete;
+		MH_TripleBuffer& operator=(const MH_TripleBuffer&) = delete;
+
+		/** The producer's buffer
+
+			@return		The buffer to write the next value to, its contents are
+						whatever was last written to it.
+		*/
+		T& Back()
+		{
+			return buffers_[back_];
+		}
+
+		/** Publish the back buffer
+
+			Makes the back buffer the newest value and takes a new back buffer,
+			either the consumer's previous buffer or a superseded one.
+		*/
+		void Publish()
+		{
+			back_ = middle_.exchange(back_ | fresh_, std::memory_order_acq_rel) & indexMask_;
+		}
+
+		/** Take the newest published buffer
+
+			@return		true if a buffer newer than Front was published, Front now refers to it.
+						false if nothing was published since the last call, Front is unchanged.
+		*/
+		bool Acquire()
+		{
+			if ((middle_.load(std::memory_order_relaxed) & fresh_) == 0)
+			{
+				return false;
+			}
+
+			front_ = middle_.exchange(front_, std::memory_order_acq_rel) & indexMask_;
+			return true;
+		}
+
+		/** The consumer's buffer
+
+			@return		The buffer most recently taken by Acquire.
+		*/
+		const T& Front() const
+		{
+			return buffers_[front_];
+		}
+	};
+} // namespace meen_hw
+
+#endif // MEEN_HW_MH_TRIPLEBUFFER_H
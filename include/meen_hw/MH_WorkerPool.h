@@ -0,0 +1,189 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEEN_HW_MH_WORKERPOOL_H
+#define MEEN_HW_MH_WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace meen_hw
+{
+	/** A basic worker pool.
+
+		Runs a batch of indexed tasks over a fixed set of worker threads,
+		the calling thread takes part in the batch. Only one batch runs at
+		a time, concurrent calls to Run are serialised.
+
+		@remark		Requires std::thread, not available on baremetal platforms.
+	*/
+	class MH_WorkerPool final
+	{
+	private:
+		/** The worker threads */
+		std::vector<std::thread> workers_;
+
+		/** Guards the batch state below */
+		std::mutex mutex_;
+
+		/** Serialises calls to Run */
+		std::mutex runMutex_;
+
+		/** Signalled when a new batch is available or the pool is exiting */
+		std::condition_variable wake_;
+
+		/** Signalled when the last worker finishes the current batch */
+		std::condition_variable done_;
+
+		/** The task to run for each index of the current batch */
+		const std::function<void(int)>* task_{};
+
+		/** The number of tasks in the current batch */
+		int taskCount_{};
+
+		/** The next task index to be claimed */
+		std::atomic<int> nextTask_{};
+
+		/** The number of workers yet to finish the current batch */
+		int busy_{};
+
+		/** Incremented for each batch so workers can tell a new batch from a spurious wake up */
+		uint64_t generation_{};
+
+		/** Set when the pool is being destroyed */
+		bool exit_{};
+
+		/** Claim and run tasks until the batch is exhausted */
+		void Drain()
+		{
+			for (int i = nextTask_.fetch_add(1); i < taskCount_; i = nextTask_.fetch_add(1))
+			{
+				(*task_)(i);
+			}
+		}
+
+		/** Worker thread entry point */
+		void Work()
+		{
+			uint64_t generation = 0;
+			std::unique_lock lock(mutex_);
+
+			while (true)
+			{
+				wake_.wait(lock, [&] { return exit_ == true || generation_ != generation; });
+
+				if (exit_ == true)
+				{
+					return;
+				}
+
+				generation = generation_;
+				lock.unlock();
+				Drain();
+				lock.lock();
+
+				if (--busy_ == 0)
+				{
+					done_.notify_one();
+				}
+			}
+		}
+
+	public:
+		/** Constructor
+
+			@param	threads		The number of worker threads to create, in addition to the calling thread.
+		*/
+		explicit MH_WorkerPool(int threads)
+		{
+			for (int i = 0; i < threads; i++)
+			{
+				workers_.emplace_back([this] { Work(); });
+			}
+		}
+
+		/** Destructor
+
+			Waits for the worker threads to exit.
+		*/
+		~MH_WorkerPool()
+		{
+			{
+				std::lock_guard lock(mutex_);
+				exit_ = true;
+			}
+
+			wake_.notify_all();
+
+			for (auto& worker : workers_)
+			{
+				worker.join();
+			}
+		}
+
+		MH_WorkerPool(const MH_WorkerPool&) = delete;
+		MH_WorkerPool& operator=(const MH_WorkerPool&) = delete;
+
+		/** The number of threads that take part in a batch
+
+			@return		The worker thread count plus the calling thread.
+		*/
+		int Size() const
+		{
+			return static_cast<int>(workers_.size()) + 1;
+		}
+
+		/** Run a batch of tasks
+
+			Calls task(i) for each i in [0, taskCount) and returns once all of them have completed.
+
+			@param	taskCount	The number of tasks in the batch.
+			@param	task		The task to run, it must be safe to call concurrently with different indices.
+		*/
+		void Run(int taskCount, const std::function<void(int)>& task)
+		{
+			std::lock_guard run(runMutex_);
+
+			{
+				std::lock_guard lock(mutex_);
+				task_ = &task;
+				taskCount_ = taskCount;
+				nextTask_ = 0;
+				busy_ = static_cast<int>(workers_.size());
+				generation_++;
+			}
+
+			wake_.notify_all();
+			Drain();
+
+			std::unique_lock lock(mutex_);
+			done_.wait(lock, [this] { return busy_ == 0; });
+		}
+	};
+} // namespace meen_hw
+
+#endif // MEEN_HW_MH_WORKERPOOL_H
@@ -0,0 +1,172 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEEN_HW_MH_BLITKERNELS_H
+#define MEEN_HW_MH_BLITKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace meen_hw::i8080_arcade
+{
+	/** 1bpp expansion table
+
+		The 256 possible patterns a compressed vram byte can expand to for a
+		given foreground/background pixel, output bpp and horizontal scale. Each of the
+		8 source pixels is repeated scale times.
+	*/
+	struct ExpandTable
+	{
+		/** Expanded pixels
+
+			Entry n holds the entryBytes output bytes for the compressed byte n in memory order.
+			Empty when the output is unscaled 1bpp, which is a straight copy.
+		*/
+		std::vector<uint8_t> pixels;
+
+		/** The number of output bytes that a single compressed byte expands to. */
+		int entryBytes{ 1 };
+
+		/** The packed foreground pixel the pixels were built with. */
+		uint32_t foreground{};
+
+		/** The packed background pixel the pixels were built with. */
+		uint32_t background{};
+	};
+
+	/** Build an expansion table
+
+		@param	table		The table to populate.
+		@param	bpp			The output bits per pixel, 1, 8, 16 or 32.
+		@param	scale		The number of times each pixel is repeated horizontally.
+		@param	foreground	The packed output pixel for a set bit (ignored for 1bpp).
+		@param	background	The packed output pixel for a clear bit (ignored for 1bpp).
+	*/
+	void BuildExpandTable(ExpandTable& table, int bpp, int scale, uint32_t foreground, uint32_t background);
+
+	/** 1bpp expansion kernel
+
+		Expands each compressed vram byte into table.entryBytes output bytes, bit 0
+		being the first (left most) pixel. A set bit is written as the foreground
+		pixel, a clear bit is written as the background pixel.
+
+		@param	dst			The destination to write to, must be at least count * table.entryBytes bytes.
+		@param	src			The compressed 1bpp pixels to expand.
+		@param	count		The number of src bytes to expand.
+		@param	table		The expansion table for the current options.
+	*/
+	using ExpandKernel = void(*)(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table);
+
+	/** Unscaled 1bpp kernel
+
+		The source is already in the output format, copy it.
+
+		@see ExpandKernel
+	*/
+	void Copy1bpp(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table);
+
+	/** Portable expansion kernel
+
+		One table load and one store of table.entryBytes per compressed byte.
+
+		@see ExpandKernel
+	*/
+	void Expand1bppTable(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table);
+
+#if defined(__x86_64__) || defined(_M_X64)
+	/** SSE2 expansion kernel
+
+		Unscaled 8bpp only, expands 16 compressed bytes (128 pixels)
+		per iteration without touching the table pixels.
+
+		@see ExpandKernel
+	*/
+	void Expand1bppTo8bppSse2(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table);
+
+	/** AVX2 expansion kernel
+
+		Unscaled 8bpp only, expands 32 compressed bytes (256 pixels) per iteration.
+
+		@remark	Must only be called when the host cpu supports AVX2.
+
+		@see ExpandKernel
+	*/
+	void Expand1bppTo8bppAvx2(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table);
+
+	/** SSE2 32bpp expansion kernel
+
+		Unscaled 32bpp only, two 16 byte stores per compressed byte.
+
+		@see ExpandKernel
+	*/
+	void Expand1bppTo32bppSse2(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table);
+
+	/** AVX2 32bpp expansion kernel
+
+		Unscaled 32bpp only, one 32 byte store per compressed byte.
+
+		@remark	Must only be called when the host cpu supports AVX2.
+
+		@see ExpandKernel
+	*/
+	void Expand1bppTo32bppAvx2(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table);
+#endif // __x86_64__ || _M_X64
+
+	/** 8x8 bit matrix transpose
+
+		Transposes an 8x8 tile of 1bpp pixels packed into a 64 bit word
+		where byte n holds row n and bit m of each byte holds column m.
+		Bit 8 * n + m is moved to bit 8 * m + n.
+
+		@param	tile		The 8x8 tile to transpose.
+
+		@return				The transposed tile.
+	*/
+	constexpr uint64_t Transpose8x8(uint64_t tile)
+	{
+		uint64_t t = (tile ^ (tile >> 7)) & 0x00AA00AA00AA00AA;
+		tile ^= t ^ (t << 7);
+		t = (tile ^ (tile >> 14)) & 0x0000CCCC0000CCCC;
+		tile ^= t ^ (t << 14);
+		t = (tile ^ (tile >> 28)) & 0x00000000F0F0F0F0;
+		return tile ^ t ^ (t << 28);
+	}
+
+	static_assert(Transpose8x8(0x0000000000000002) == 0x0000000000000100);
+	static_assert(Transpose8x8(0x8040201008040201) == 0x8040201008040201);
+	static_assert(Transpose8x8(0x00000000000000FF) == 0x0101010101010101);
+
+	/** Select an expansion kernel
+
+		Queries the host cpu (once) for the fastest supported expansion kernel.
+
+		@param	bpp			The output bits per pixel, 1, 8, 16 or 32.
+		@param	scale		The number of times each pixel is repeated horizontally.
+
+		@return		AVX2 or SSE2 for unscaled 8bpp and 32bpp on x86_64 when supported, a copy
+					for unscaled 1bpp, otherwise the table kernel specialised for the entry size.
+	*/
+	ExpandKernel SelectExpandKernel(int bpp, int scale);
+} // namespace meen_hw::i8080_arcade
+
+#endif // MEEN_HW_MH_BLITKERNELS_H
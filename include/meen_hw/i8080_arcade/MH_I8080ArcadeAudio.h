@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef MEEN_HW_MH_I8080ARCADEAUDIO_H
+#define MEEN_HW_MH_I8080ARCADEAUDIO_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+#include "meen_hw/MH_RingBuffer.h"
+
+namespace meen_hw::i8080_arcade
+{
+	/** i8080 arcade discrete sound synthesiser
+
+		Models the SX0 - SX10 discrete sound circuits driven by output ports 3
+		and 5 and renders them to signed 16 bit mono PCM at a configurable host
+		sample rate. Every sound is a voice made of a square or triangle tone
+		with an optional pitch sweep and vibrato, mixed with LFSR noise, under
+		an exponentially decaying envelope. All the rendering is integer fixed
+		point so it runs on cores without an FPU and produces bit identical
+		output on every platform.
+
+		Port writes are queued on a lock-free ring and sample rate changes are
+		posted to an atomic, both are applied at the start of the next Render
+		call, so Write and SetSampleRate can be called from the cpu thread while
+		Render is called from the audio thread.
+	*/
+	class MH_I8080ArcadeAudio final
+	{
+	private:
+		/** The number of discrete sounds, SX0 to SX10 */
+		static constexpr int soundCount_ = 11;
+
+		/** A discrete sound's parameters in host independent units */
+		struct Sound
+		{
+			uint16_t startHz;		/**< The tone frequency when triggered. */
+			uint16_t endHz;			/**< The tone frequency at the end of the sound, the pitch sweeps linearly. */
+			uint16_t vibratoHz;		/**< The vibrato rate, 0 for none. */
+			uint16_t vibratoDepthHz;/**< How far the vibrato moves the tone frequency either way. */
+			uint16_t noiseHz;		/**< The rate the noise generator is clocked at. */
+			uint8_t noise;			/**< The noise level mixed with the tone, 0 (tone only) to 255 (noise only). */
+			bool triangle;			/**< A triangle tone instead of a square one. */
+			uint16_t gateHz;		/**< Pulse the sound on and off at this rate, 0 for a continuous sound. */
+			uint16_t lengthMs;		/**< The length of a one shot sound, 0 repeats until the port bit is cleared. */
+			uint16_t decayMs;		/**< The envelope time constant, 0 for a constant level. */
+			uint16_t level;			/**< The initial level, Q16. */
+		};
+
+		/** A sounding voice, all fixed point */
+		struct Voice
+		{
+			bool active{};
+			uint32_t phase{};			/**< Tone phase, Q32 cycles. */
+			int64_t step{};				/**< Tone phase step per sample, Q32 cycles. */
+			int64_t sweep{};			/**< Added to step each sample. */
+			uint32_t vibratoPhase{};
+			uint32_t vibratoStep{};
+			int64_t vibratoDepth{};		/**< Peak step deviation. */
+			uint32_t noisePhase{};
+			uint32_t noiseStep{};
+			uint32_t lfsr{ 1 };			/**< 17 bit noise shift register. */
+			uint32_t gatePhase{};
+			uint32_t gateStep{};
+			uint32_t level{};			/**< Envelope level, Q24. */
+			uint32_t decay{};			/**< Envelope multiplier per sample, Q24. */
+			uint32_t remaining{};		/**< Samples left of a one shot sound. */
+			bool loop{};
+		};
+
+		static const std::array<Sound, soundCount_> sounds_;
+
+		std::array<Voice, soundCount_> voices_{};
+
+		/** The sample rate the voices are rendered at, owned by Render */
+		uint32_t sampleRate_{};
+
+		/** The sample rate most recently set and whether Render has still to apply it */
+		std::atomic<uint32_t> requestedRate_{};
+		std::atomic<bool> rateChanged_{};
+
+		/** The port values last applied, used to find rising and falling edges */
+		uint8_t port3_{};
+		uint8_t port5_{};
+
+		/** Port writes, (port << 8) | data, from Write to Render */
+		MH_RingBuffer<uint16_t, 256> events_;
+
+		/** The latest port values written, Render applies them when a write was dropped from a full ring */
+		std::atomic<uint8_t> latestPort3_{};
+		std::atomic<uint8_t> latestPort5_{};
+
+		/** Writes dropped from a full ring, only ever stored by Write, and the count Render has reconciled */
+		std::atomic<uint32_t> dropped_{};
+		uint32_t droppedSeen_{};
+
+		void Trigger(int sx);
+		void Apply(uint8_t port, uint8_t data);
+		int32_t Sample(Voice& voice);
+
+	public:
+		/** Constructor
+
+			@param	sampleRate	The host sample rate in Hz.
+		*/
+		explicit MH_I8080ArcadeAudio(uint32_t sampleRate = 44100);
+
+		/** Change the host sample rate
+
+			The change takes effect at the start of the next Render call, before
+			any queued port writes are applied, and stops the sounding voices.
+		*/
+		void SetSampleRate(uint32_t sampleRate);
+
+		/** The host sample rate
+
+			@return		The rate most recently set, it may not be applied until the next Render call.
+		*/
+		uint32_t GetSampleRate() const;
+
+		/** Queue an audio port write
+
+			@param	port	3 or 5, other ports are ignored.
+			@param	data	The value written to the port.
+
+			@return			false if the queue is full. The write's sound triggers are lost, but its
+							port value is still applied by the next Render call.
+		*/
+		bool Write(uint8_t port, uint8_t data);
+
+		/** Render the next samples
+
+			Applies a pending sample rate change, the queued port writes and the latest
+			port values when a write was dropped, and then renders, the output is silent
+			while the amplifier (port 3 bit 5, SX5) is disabled.
+
+			@param	samples		Receives signed 16 bit mono samples.
+		*/
+		void Render(std::span<int16_t> samples);
+	};
+} // namespace meen_hw::i8080_arcade
+
+#endif // MEEN_HW_MH_I8080ARCADEAUDIO_H
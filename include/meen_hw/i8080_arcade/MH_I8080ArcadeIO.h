@@ -23,7 +23,17 @@ SOFTWARE.
 #ifndef MEEN_HW_MH_I8080ARCADEIO_H
 #define MEEN_HW_MH_I8080ARCADEIO_H
 
+#include <memory>
+#include <vector>
+
 #include "meen_hw/MH_II8080ArcadeIO.h"
+#include "meen_hw/i8080_arcade/MH_I8080ArcadeAudio.h"
+#include "meen_hw/i8080_arcade/MH_BlitKernels.h"
+
+namespace meen_hw
+{
+	class MH_WorkerPool;
+}
 
 namespace meen_hw::i8080_arcade
 {
@@ -45,7 +55,25 @@ namespace meen_hw::i8080_arcade
 			Native		= 0 << 0,				/**< Native pixel format (1bpp) and resolution (256 x 224). */
 			Rgb332		= 1 << 0,				/**< 8 bits per pixel with native resolution. */
 			Upright		= 1 << 1,				/**< Native pixel format with a resolution of 224 x 256. */
-			Upright8bpp = Upright | Rgb332		/**< 8 bits per pixel with a resolution of 224 x 256. */
+			Upright8bpp = Upright | Rgb332,		/**< 8 bits per pixel with a resolution of 224 x 256. */
+			Rgb16		= 1 << 2,				/**< 16 bits per pixel, packed according to format16_. */
+			Rgb32		= 1 << 3,				/**< 32 bits per pixel, packed according to format32_. */
+			ColourMask	= Rgb332 | Rgb16 | Rgb32	/**< The bits that select the destination pixel depth. */
+		};
+
+		/** Direct colour pixel formats
+
+			The component order of 16 and 32 bit destination pixels, named
+			from the most significant to the least significant component.
+		*/
+		enum PixelFormat
+		{
+			Rgb565,			/**< 5 bits red, 6 bits green, 5 bits blue. */
+			Bgr565,			/**< 5 bits blue, 6 bits green, 5 bits red. */
+			Argb8888,		/**< 8 bits alpha, red, green and blue. */
+			Abgr8888,		/**< 8 bits alpha, blue, green and red. */
+			Rgba8888,		/**< 8 bits red, green, blue and alpha. */
+			Bgra8888		/**< 8 bits blue, green, red and alpha. */
 		};
 
 		/** The next interrupt to execute
@@ -66,6 +94,64 @@ namespace meen_hw::i8080_arcade
 			at 60hz intervals.
 		*/
 		uint64_t lastTime_{};
+
+		/** The i8080 arcade cpu clock in Hz */
+		static constexpr uint64_t cpuClock_ = 1996800;
+
+		/** The number of cpu cycles between the two screen interrupts, half a 60hz frame */
+		static constexpr uint64_t cyclesPerInterrupt_ = cpuClock_ / 60 / 2;
+
+		/** Cycle based interrupt timing
+
+			When true `GenerateInterrupt` fires on the cycle count instead of the cpu time.
+		*/
+		bool cycleTiming_{};
+
+		/** The cycle count at which the next interrupt fires when cycleTiming_ is set */
+		uint64_t nextInterruptCycle_{ cyclesPerInterrupt_ };
+
+		/** Frame skipping
+
+			frame_ counts the frames started (interrupt 1), the blit methods skip
+			skipFrames_ of every skipPeriod_ frames.
+		*/
+		uint64_t frame_{};
+		uint8_t skipFrames_{};
+		uint8_t skipPeriod_{ 1 };
+
+		/** Raster model
+
+			128 cycles per scanline, 260 scanlines per frame, 224 of them visible. The
+			beam reaches vBlank (scanline 224) on the cycle that interrupt 2 fires.
+		*/
+		static constexpr uint64_t cyclesPerScanline_ = 128;
+		static constexpr uint64_t cyclesPerFrame_ = cyclesPerInterrupt_ * 2;
+		static constexpr uint64_t beamOffset_ = 224 * cyclesPerScanline_;
+
+		/** The source rows the beam has drawn when interrupt 1 fires (scanline 94), in whole 8 row tiles */
+		static constexpr int isr1Rows_ = static_cast<int>((cyclesPerInterrupt_ + beamOffset_) % cyclesPerFrame_ / cyclesPerScanline_) & ~0x07;
+
+		/** The raster model frame and the next source row BlitVRAMToBeam will blit */
+		uint64_t beamFrame_{};
+		int beamRow_{};
+
+		/** The number of 8 row tiles in each band handed to a BlitVRAMParallel executor
+
+			The 224 source rows are 28 tiles, so 4 tile bands give an executor 7 bands.
+			That is enough for a pool of up to 7 threads to take one each, or for fewer
+			threads to balance the uneven bands between them. Smaller bands would add a
+			task dispatch and a band setup for little gain, an upright band has to walk
+			each of its 8x8 tiles whatever its size.
+		*/
+		static constexpr int bandTiles_ = 4;
+
+		/** The worker pool BlitVRAMParallel uses when no executor is given
+
+			Created on first use and owned by this instance, so its threads are joined
+			when the instance is destroyed and separate instances never share a pool.
+			Always empty on platforms without thread support.
+		*/
+		std::unique_ptr<MH_WorkerPool> workerPool_;
 		
 		/** Dedicated Shift Hardware
 
@@ -94,6 +180,9 @@ namespace meen_hw::i8080_arcade
 		//cppcheck-suppress unusedStructMember
 		uint8_t port5Byte_{};
 
+		/** The discrete sound circuits driven by ports 3 and 5 */
+		MH_I8080ArcadeAudio audio_;
+
 		/** Render mode
 
 			A combination of flags that determine how the video ram
@@ -119,7 +208,198 @@ namespace meen_hw::i8080_arcade
 		*/
 		uint8_t colour_{ 0xFF };
 
+		/** Foreground colour as 0xRRGGBB
+
+			The full precision foreground colour used by the 16 and 32 bit
+			formats. A six digit "colour" property is used as is, any other
+			colour is widened from colour_.
+
+			@see colour_
+		*/
+		uint32_t rgb_{ 0xFFFFFF };
+
+		/** 16 bit pixel format
+
+			The value can be set using the "format" property in the config.json.
+
+			@remark	The default format is PixelFormat::Rgb565.
+		*/
+		uint8_t format16_{ PixelFormat::Rgb565 };
+
+		/** 32 bit pixel format
+
+			The value can be set using the "format" property in the config.json.
+
+			@remark	The default format is PixelFormat::Argb8888.
+		*/
+		uint8_t format32_{ PixelFormat::Argb8888 };
+
+		/** Output scale
+
+			The number of times each source pixel is repeated horizontally and
+			vertically. The value can be set using the "scale" property in the
+			config.json.
+
+			@remark	The default scale is 1 (native resolution).
+		*/
+		uint8_t scale_{ 1 };
+
+		/** 1bpp expansion kernel
+
+			The fastest kernel supported by the host cpu for the current
+			blit mode and scale, used to write each destination scanline.
+
+			@see SelectExpandKernel
+		*/
+		ExpandKernel expand_{ SelectExpandKernel(1, 1) };
+
+		/** 1bpp expansion table
+
+			The pixel patterns for colour_, rebuilt by `SetOptions`
+			whenever the "colour", "bpp", "format" or "scale" properties are set.
+
+			@see colour_
+			@see scale_
+		*/
+		ExpandTable expandTable_;
+
+		/** A coloured overlay (gel) band
+
+			A rectangle of the upright screen (224 x 256) that is drawn
+			in its own foreground colour instead of colour_.
+
+			@remark	All edges are multiples of 8 pixels so that a band always
+					covers whole compressed vram bytes in either orientation.
+		*/
+		struct OverlayBand
+		{
+			MH_Rect rect{};
+			uint8_t colour{};
+			uint32_t rgb{};
+		};
+
+		/** Overlay bands
+
+			The bands set by the "overlay" property in the config.json, later
+			bands are drawn over earlier ones.
+
+			@remark	The default is no overlay.
+		*/
+		std::vector<OverlayBand> overlayBands_;
+
+		/** Overlay map
+
+			One entry per compressed vram byte of an 8 row source tile (28 x 32),
+			0 selects expandTable_ and n selects overlayTables_[n - 1].
+			Empty when there is no overlay.
+		*/
+		std::vector<uint8_t> overlay_;
+
+		/** Overlay expansion tables
+
+			The expansion table for each of overlayBands_, rebuilt alongside expandTable_.
+		*/
+		std::vector<ExpandTable> overlayTables_;
+
+		/** Previous source vram
+
+			A copy of the source vram from the last call to `BlitVRAMIncremental`,
+			empty when the next incremental blit needs to be a full blit.
+		*/
+		std::vector<uint8_t> prevVRAM_;
+
+		/** Blit kernel
+
+			A BlitRowsT specialisation for the current blit mode.
+		*/
+		using BlitKernel = void (MH_I8080ArcadeIO::*)(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, int firstRow, int lastRow);
+
+		/** The blit kernel selected by `SelectBlitKernel`
+
+			@see BlitRowsT
+		*/
+		BlitKernel blit_{};
+
+		/** Blit a range of source scanlines
+
+			@param	dst			The video memory to write to.
+			@param	rowBytes	The width of each dst scanline in bytes.
+			@param	src			The video ram to copy.
+			@param	firstRow	The first source scanline to blit.
+			@param	lastRow		One past the last source scanline to blit.
+
+			@remark	Upright blits are rounded out to multiples of 8 scanlines.
+		*/
+		void BlitRows(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, int firstRow, int lastRow);
+
+		/** Blit a range of source scanlines for a fixed blit mode
+
+			The orientation, scale and overlay are compile time constants so the
+			scanline loops carry no mode tests, the pixel depth is handled by expand_.
+
+			@tparam	Upright		Rotate the output to a 224 x 256 upright screen.
+			@tparam	Scaled		The scale is greater than 1, each scanline is replicated.
+			@tparam	Overlay		Split each scanline into runs of overlayTables_.
+
+			@see BlitRows
+		*/
+		template<bool Upright, bool Scaled, bool Overlay>
+		void BlitRowsT(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, int firstRow, int lastRow);
+
+		/** Select blit_ for the current orientation, scale and overlay
+		*/
+		void SelectBlitKernel();
+
+		/** The destination region covered by a range of source scanlines
+
+			@param	firstRow	The first source scanline.
+			@param	lastRow		One past the last source scanline.
+
+			@return				The destination rectangle in pixels.
+		*/
+		MH_Rect RowsToRect(int firstRow, int lastRow) const;
+
+		/** The destination bits per pixel
+
+			@return				1, 8, 16 or 32 depending on blitMode_.
+		*/
+		int Bpp() const;
+
+		/** Pack a colour into a direct colour pixel
+
+			@param	format		The PixelFormat to pack into.
+			@param	rgb			The colour as 0xRRGGBB.
+
+			@return				The packed pixel, alpha (where present) is opaque.
+		*/
+		static uint32_t PackPixel(uint8_t format, uint32_t rgb);
+
+		/** Rebuild expandTable_, overlayTables_ and expand_ for the current blit mode, colour, format and scale
+		*/
+		void UpdateExpandTable();
+
+		/** Validate and apply a set of overlay bands
+
+			@param	bands		The bands to apply, an empty set removes the overlay.
+
+			@return				false if any band is out of bounds or not 8 pixel aligned,
+								the current overlay is left unchanged.
+		*/
+		bool SetOverlay(std::vector<OverlayBand>&& bands);
+
 	public:
+		/** Default constructor
+
+			Builds the expansion table for the default colour.
+		*/
+		MH_I8080ArcadeIO();
+
+		/** Destructor
+
+			Joins the worker pool threads, if any.
+		*/
+		~MH_I8080ArcadeIO();
+
 		/** Read from the specified port
 
 			@see MH_II8080ArcadeIO::ReadPort
@@ -138,12 +418,60 @@ namespace meen_hw::i8080_arcade
 		*/
 		uint8_t GenerateInterrupt(uint64_t currTime, uint64_t cycles) final;
 
+		/** CyclesUntilInterrupt
+
+			@see MH_II8080ArcadeIO::CyclesUntilInterrupt
+		*/
+		uint64_t CyclesUntilInterrupt(uint64_t cycles) const final;
+
+		/** FrameSkipped
+
+			@see MH_II8080ArcadeIO::FrameSkipped
+		*/
+		bool FrameSkipped() const final;
+
+		/** GetScanline
+
+			@see MH_II8080ArcadeIO::GetScanline
+		*/
+		int GetScanline(uint64_t cycles) const final;
+
+		/** RenderAudio
+
+			@see MH_II8080ArcadeIO::RenderAudio
+		*/
+		void RenderAudio(std::span<int16_t> samples) final;
+
 		/** Write i8080 arcade vram to texture
 		
 			@see MH_II8080ArcadeIO::BlitVRAM
 		*/
 		void BlitVRAM(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src) final;
 
+		/** Write the changed i8080 arcade vram to texture
+
+			@see MH_II8080ArcadeIO::BlitVRAMIncremental
+		*/
+		int BlitVRAMIncremental(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, std::span<MH_Rect> dirtyRects) final;
+
+		/** Write i8080 arcade vram to texture using multiple threads
+
+			@see MH_II8080ArcadeIO::BlitVRAMParallel
+		*/
+		void BlitVRAMParallel(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, const MH_BlitExecutor& executor) final;
+
+		/** Blit the half of the vram the beam has just drawn
+
+			@see MH_II8080ArcadeIO::BlitVRAMHalf
+		*/
+		MH_Rect BlitVRAMHalf(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, uint8_t isr) final;
+
+		/** Blit the vram rows the beam has passed
+
+			@see MH_II8080ArcadeIO::BlitVRAMToBeam
+		*/
+		MH_Rect BlitVRAMToBeam(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, uint64_t cycles) final;
+
 		/** Blit options
 
 			@see MH_II8080ArcadeIO::BlitVRAM
@@ -50,6 +50,18 @@ namespace meen_hw
 						return "The orientation configuration parameter is invalid";
 					case errc::json_parse:
 						return "A json parse error occurred while processing the configuration file";
+					case errc::scale:
+						return "The scale configuration parameter is invalid";
+					case errc::format:
+						return "The format configuration parameter is invalid";
+					case errc::overlay:
+						return "The overlay configuration parameter is invalid";
+					case errc::timing:
+						return "The timing configuration parameter is invalid";
+					case errc::frame_skip:
+						return "The frame-skip configuration parameter is invalid";
+					case errc::audio_rate:
+						return "The audio-rate configuration parameter is invalid";
 					default:
 						return "Unknown error code";
 				}
@@ -0,0 +1,289 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#include "meen_hw/i8080_arcade/MH_BlitKernels.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define MH_TARGET_AVX2
+#endif
+
+namespace meen_hw::i8080_arcade
+{
+	void BuildExpandTable(ExpandTable& table, int bpp, int scale, uint32_t foreground, uint32_t background)
+	{
+		table.foreground = foreground;
+		table.background = background;
+
+		if (bpp == 1)
+		{
+			table.entryBytes = scale;
+
+			if (scale == 1)
+			{
+				table.pixels.clear();
+				return;
+			}
+		}
+		else
+		{
+			table.entryBytes = 8 * scale * (bpp / 8);
+		}
+
+		table.pixels.assign(256 * table.entryBytes, 0);
+
+		for (int i = 0; i < 256; i++)
+		{
+			auto entry = table.pixels.data() + i * table.entryBytes;
+
+			for (int pixel = 0; pixel < 8 * scale; pixel++)
+			{
+				// The source bit that this output pixel is a copy of
+				auto set = (i >> (pixel / scale)) & 0x01;
+
+				if (bpp == 1)
+				{
+					entry[pixel >> 3] |= set << (pixel & 0x07);
+				}
+				else if (bpp == 8)
+				{
+					entry[pixel] = static_cast<uint8_t>(set ? foreground : background);
+				}
+				else if (bpp == 16)
+				{
+					auto value = static_cast<uint16_t>(set ? foreground : background);
+					memcpy(entry + pixel * sizeof(value), &value, sizeof(value));
+				}
+				else
+				{
+					auto value = set ? foreground : background;
+					memcpy(entry + pixel * sizeof(value), &value, sizeof(value));
+				}
+			}
+		}
+	}
+
+	void Copy1bpp(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable&)
+	{
+		memcpy(dst, src, count);
+	}
+
+	template<int EntryBytes>
+	static void Expand1bppTableN(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table)
+	{
+		auto pixels = table.pixels.data();
+
+		for (auto end = src + count; src < end; src++, dst += EntryBytes)
+		{
+			memcpy(dst, pixels + *src * EntryBytes, EntryBytes);
+		}
+	}
+
+	// The table kernel specialised for each supported entry size, so the copies become plain stores.
+	static ExpandKernel TableKernel(int entryBytes)
+	{
+		switch (entryBytes)
+		{
+			case 2: return Expand1bppTableN<2>;
+			case 3: return Expand1bppTableN<3>;
+			case 4: return Expand1bppTableN<4>;
+			case 8: return Expand1bppTableN<8>;
+			case 16: return Expand1bppTableN<16>;
+			case 24: return Expand1bppTableN<24>;
+			case 32: return Expand1bppTableN<32>;
+			case 48: return Expand1bppTableN<48>;
+			case 64: return Expand1bppTableN<64>;
+			case 96: return Expand1bppTableN<96>;
+			case 128: return Expand1bppTableN<128>;
+			default: return nullptr;
+		}
+	}
+
+	void Expand1bppTable(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table)
+	{
+		if (auto kernel = TableKernel(table.entryBytes); kernel != nullptr)
+		{
+			kernel(dst, src, count, table);
+			return;
+		}
+
+		auto pixels = table.pixels.data();
+
+		for (auto end = src + count; src < end; src++, dst += table.entryBytes)
+		{
+			memcpy(dst, pixels + *src * table.entryBytes, table.entryBytes);
+		}
+	}
+
+#if defined(__x86_64__) || defined(_M_X64)
+	void Expand1bppTo8bppSse2(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table)
+	{
+		const __m128i bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+		const __m128i colours = _mm_set1_epi8(static_cast<char>(table.foreground));
+
+		auto expand = [&](__m128i pixels)
+		{
+			auto mask = _mm_cmpeq_epi8(_mm_and_si128(pixels, bits), bits);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_and_si128(mask, colours));
+			dst += 16;
+		};
+
+		auto end = src + (count & ~size_t{ 15 });
+
+		for (; src < end; src += 16)
+		{
+			auto in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+			// Replicate each source byte 8 times: b0 x 8, b1 x 8, ...
+			auto lo = _mm_unpacklo_epi8(in, in);
+			auto hi = _mm_unpackhi_epi8(in, in);
+			auto q0 = _mm_unpacklo_epi16(lo, lo);
+			auto q1 = _mm_unpackhi_epi16(lo, lo);
+			auto q2 = _mm_unpacklo_epi16(hi, hi);
+			auto q3 = _mm_unpackhi_epi16(hi, hi);
+
+			expand(_mm_unpacklo_epi32(q0, q0));
+			expand(_mm_unpackhi_epi32(q0, q0));
+			expand(_mm_unpacklo_epi32(q1, q1));
+			expand(_mm_unpackhi_epi32(q1, q1));
+			expand(_mm_unpacklo_epi32(q2, q2));
+			expand(_mm_unpackhi_epi32(q2, q2));
+			expand(_mm_unpacklo_epi32(q3, q3));
+			expand(_mm_unpackhi_epi32(q3, q3));
+		}
+
+		Expand1bppTable(dst, src, count & 15, table);
+	}
+
+	MH_TARGET_AVX2 void Expand1bppTo8bppAvx2(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table)
+	{
+		const __m256i bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+											  1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+		// Lane 0 replicates source bytes 0 and 1, lane 1 replicates source bytes 2 and 3.
+		const __m256i replicate = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+												   2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+		const __m256i colours = _mm256_set1_epi8(static_cast<char>(table.foreground));
+		auto end = src + (count & ~size_t{ 3 });
+
+		for (; src < end; src += 4, dst += 32)
+		{
+			int32_t quad;
+			memcpy(&quad, src, sizeof(quad));
+			auto pixels = _mm256_shuffle_epi8(_mm256_set1_epi32(quad), replicate);
+			auto mask = _mm256_cmpeq_epi8(_mm256_and_si256(pixels, bits), bits);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_and_si256(mask, colours));
+		}
+
+		Expand1bppTable(dst, src, count & 3, table);
+	}
+
+	void Expand1bppTo32bppSse2(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table)
+	{
+		const __m128i bitsLo = _mm_setr_epi32(1, 2, 4, 8);
+		const __m128i bitsHi = _mm_setr_epi32(16, 32, 64, 128);
+		const __m128i foreground = _mm_set1_epi32(static_cast<int>(table.foreground));
+		const __m128i background = _mm_set1_epi32(static_cast<int>(table.background));
+
+		for (auto end = src + count; src < end; src++, dst += 32)
+		{
+			auto pixels = _mm_set1_epi32(*src);
+			auto lo = _mm_cmpeq_epi32(_mm_and_si128(pixels, bitsLo), bitsLo);
+			auto hi = _mm_cmpeq_epi32(_mm_and_si128(pixels, bitsHi), bitsHi);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(_mm_and_si128(lo, foreground), _mm_andnot_si128(lo, background)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), _mm_or_si128(_mm_and_si128(hi, foreground), _mm_andnot_si128(hi, background)));
+		}
+	}
+
+	MH_TARGET_AVX2 void Expand1bppTo32bppAvx2(uint8_t* dst, const uint8_t* src, size_t count, const ExpandTable& table)
+	{
+		const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		const __m256i foreground = _mm256_set1_epi32(static_cast<int>(table.foreground));
+		const __m256i background = _mm256_set1_epi32(static_cast<int>(table.background));
+
+		for (auto end = src + count; src < end; src++, dst += 32)
+		{
+			auto pixels = _mm256_set1_epi32(*src);
+			auto mask = _mm256_cmpeq_epi32(_mm256_and_si256(pixels, bits), bits);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_blendv_epi8(background, foreground, mask));
+		}
+	}
+
+	static bool HasAvx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		__cpuid(info, 1);
+
+		// The OS must save the ymm registers (OSXSAVE and AVX, then XCR0 bits 1 and 2).
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 0x06) != 0x06)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif // __x86_64__ || _M_X64
+
+	ExpandKernel SelectExpandKernel(int bpp, int scale)
+	{
+		if (bpp == 1 && scale == 1)
+		{
+			return Copy1bpp;
+		}
+#if defined(__x86_64__) || defined(_M_X64)
+		// SSE2 is part of the x86_64 baseline.
+		static const bool avx2 = HasAvx2();
+
+		if (bpp == 8 && scale == 1)
+		{
+			return avx2 == true ? Expand1bppTo8bppAvx2 : Expand1bppTo8bppSse2;
+		}
+
+		if (bpp == 32 && scale == 1)
+		{
+			return avx2 == true ? Expand1bppTo32bppAvx2 : Expand1bppTo32bppSse2;
+		}
+#endif
+		// Resolve the entry size now rather than on every call.
+		auto kernel = TableKernel(bpp == 1 ? scale : 8 * scale * (bpp / 8));
+		return kernel != nullptr ? kernel : Expand1bppTable;
+	}
+} // namespace meen_hw::i8080_arcade
@@ -0,0 +1,249 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include "meen_hw/i8080_arcade/MH_I8080ArcadeAudio.h"
+
+namespace meen_hw::i8080_arcade
+{
+	// Approximations of the Space Invaders discrete sound boards, indexed by SX number.
+	const std::array<MH_I8080ArcadeAudio::Sound, MH_I8080ArcadeAudio::soundCount_> MH_I8080ArcadeAudio::sounds_
+	{{
+		//  start   end  vibrato depth  noise   mix  triangle  gate  length  decay  level
+		{     700,  700,      8,  200,     0,    0,  true,       0,      0,     0, 0x5000 },	// SX0 UFO, repeats
+		{    1400,  200,      0,    0,  8000,   64,  false,      0,    250,   120, 0x6000 },	// SX1 Shot
+		{     200,   60,      0,    0,  3000,  224,  false,      0,   1200,   400, 0x8000 },	// SX2 Flash (player die)
+		{     900,  150,      0,    0, 12000,  160,  false,      0,    300,   100, 0x7000 },	// SX3 Invader die
+		{    1000, 1000,      0,    0,     0,    0,  false,     16,   1000,     0, 0x4000 },	// SX4 Extended play
+		{       0,    0,      0,    0,     0,    0,  false,      0,      0,     0,      0 },	// SX5 Amp enable, not a sound
+		{     110,  110,      0,    0,     0,    0,  false,      0,     90,    60, 0x8000 },	// SX6 Fleet movement 1
+		{      98,   98,      0,    0,     0,    0,  false,      0,     90,    60, 0x8000 },	// SX7 Fleet movement 2
+		{      87,   87,      0,    0,     0,    0,  false,      0,     90,    60, 0x8000 },	// SX8 Fleet movement 3
+		{      82,   82,      0,    0,     0,    0,  false,      0,     90,    60, 0x8000 },	// SX9 Fleet movement 4
+		{     900,  300,     24,  250,     0,    0,  true,       0,   1000,   500, 0x6000 }	// SX10 UFO hit
+	}};
+
+	// Q32 phase step per sample for a frequency.
+	static uint32_t HzToStep(uint32_t hz, uint32_t sampleRate)
+	{
+		return static_cast<uint32_t>((static_cast<uint64_t>(hz) << 32) / sampleRate);
+	}
+
+	// A triangle wave from a Q32 phase, -32768 to 32767.
+	static int32_t Triangle(uint32_t phase)
+	{
+		auto t = static_cast<int32_t>(phase >> 16);
+		return t < 32768 ? t * 2 - 32768 : (65535 - t) * 2 - 32767;
+	}
+
+	MH_I8080ArcadeAudio::MH_I8080ArcadeAudio(uint32_t sampleRate)
+		: sampleRate_{ sampleRate }
+		, requestedRate_{ sampleRate }
+	{
+	}
+
+	void MH_I8080ArcadeAudio::SetSampleRate(uint32_t sampleRate)
+	{
+		requestedRate_.store(sampleRate, std::memory_order_relaxed);
+		rateChanged_.store(true, std::memory_order_release);
+	}
+
+	uint32_t MH_I8080ArcadeAudio::GetSampleRate() const
+	{
+		return requestedRate_.load(std::memory_order_relaxed);
+	}
+
+	bool MH_I8080ArcadeAudio::Write(uint8_t port, uint8_t data)
+	{
+		if (port != 3 && port != 5)
+		{
+			return true;
+		}
+
+		// Published before the push so Render never reconciles against an older value than it has popped.
+		(port == 3 ? latestPort3_ : latestPort5_).store(data, std::memory_order_relaxed);
+
+		if (events_.Push(static_cast<uint16_t>(port << 8 | data)) == false)
+		{
+			// Single producer, a load and store keeps it lock-free on cores without atomic read modify write.
+			dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+			return false;
+		}
+
+		return true;
+	}
+
+	void MH_I8080ArcadeAudio::Trigger(int sx)
+	{
+		const auto& sound = sounds_[sx];
+		auto& voice = voices_[sx];
+		auto length = static_cast<uint32_t>(static_cast<uint64_t>(sound.lengthMs) * sampleRate_ / 1000);
+
+		voice = Voice{};
+		voice.active = true;
+		voice.loop = sound.lengthMs == 0;
+		voice.remaining = length;
+		voice.step = HzToStep(sound.startHz, sampleRate_);
+		voice.sweep = voice.loop == true ? 0 : (static_cast<int64_t>(HzToStep(sound.endHz, sampleRate_)) - voice.step) / std::max<uint32_t>(length, 1);
+		voice.vibratoStep = HzToStep(sound.vibratoHz, sampleRate_);
+		voice.vibratoDepth = HzToStep(sound.vibratoDepthHz, sampleRate_);
+		voice.noiseStep = HzToStep(sound.noiseHz, sampleRate_);
+		voice.gateStep = HzToStep(sound.gateHz, sampleRate_);
+		voice.level = static_cast<uint32_t>(sound.level) << 8;
+		// 1 - 1 / (time constant in samples), close to e^(-1 / samples) for the lengths used here.
+		voice.decay = sound.decayMs == 0 ? 1 << 24 : (1 << 24) - static_cast<uint32_t>((1000ull << 24) / (static_cast<uint64_t>(sound.decayMs) * sampleRate_));
+	}
+
+	void MH_I8080ArcadeAudio::Apply(uint8_t port, uint8_t data)
+	{
+		if (port == 3)
+		{
+			uint8_t rising = data & ~port3_;
+
+			// SX0 - SX4, SX5 enables the amplifier
+			for (int sx = 0; sx < 5; sx++)
+			{
+				if (rising & (1 << sx))
+				{
+					Trigger(sx);
+				}
+			}
+
+			// The ufo repeats until its bit is cleared
+			if ((data & 0x01) == 0)
+			{
+				voices_[0].active = false;
+			}
+
+			port3_ = data;
+		}
+		else
+		{
+			uint8_t rising = data & ~port5_;
+
+			// SX6 - SX10
+			for (int bit = 0; bit < 5; bit++)
+			{
+				if (rising & (1 << bit))
+				{
+					Trigger(bit + 6);
+				}
+			}
+
+			port5_ = data;
+		}
+	}
+
+	int32_t MH_I8080ArcadeAudio::Sample(Voice& voice)
+	{
+		auto step = voice.step;
+
+		if (voice.vibratoStep != 0)
+		{
+			voice.vibratoPhase += voice.vibratoStep;
+			step += voice.vibratoDepth * Triangle(voice.vibratoPhase) / 32768;
+		}
+
+		voice.phase += static_cast<uint32_t>(step);
+		voice.step += voice.sweep;
+
+		const auto& sound = sounds_[&voice - voices_.data()];
+		int32_t value = sound.triangle == true ? Triangle(voice.phase) : (voice.phase & 0x80000000 ? 32767 : -32767);
+
+		if (sound.noise != 0)
+		{
+			auto previous = voice.noisePhase;
+			voice.noisePhase += voice.noiseStep;
+
+			// Clock the shift register each time the noise phase wraps, taps 17 and 14.
+			if (voice.noisePhase < previous)
+			{
+				voice.lfsr = ((voice.lfsr >> 1) | (((voice.lfsr ^ (voice.lfsr >> 3)) & 1) << 16)) & 0x1FFFF;
+			}
+
+			int32_t noise = voice.lfsr & 1 ? 32767 : -32767;
+			value = (value * (256 - sound.noise) + noise * sound.noise) / 256;
+		}
+
+		if (voice.gateStep != 0)
+		{
+			voice.gatePhase += voice.gateStep;
+			value = voice.gatePhase & 0x80000000 ? 0 : value;
+		}
+
+		auto out = static_cast<int32_t>(static_cast<int64_t>(value) * voice.level >> 24);
+		voice.level = static_cast<uint32_t>(static_cast<uint64_t>(voice.level) * voice.decay >> 24);
+
+		if (voice.loop == false && --voice.remaining == 0)
+		{
+			voice.active = false;
+		}
+
+		return out;
+	}
+
+	void MH_I8080ArcadeAudio::Render(std::span<int16_t> samples)
+	{
+		uint16_t event;
+
+		if (rateChanged_.exchange(false, std::memory_order_acquire) == true)
+		{
+			sampleRate_ = requestedRate_.load(std::memory_order_relaxed);
+
+			for (auto& voice : voices_)
+			{
+				voice.active = false;
+			}
+		}
+
+		while (events_.Pop(event) == true)
+		{
+			Apply(static_cast<uint8_t>(event >> 8), static_cast<uint8_t>(event));
+		}
+
+		// The port state must not be lossy, a stale ufo bit would loop forever.
+		if (auto dropped = dropped_.load(std::memory_order_acquire); dropped != droppedSeen_)
+		{
+			droppedSeen_ = dropped;
+			Apply(3, latestPort3_.load(std::memory_order_relaxed));
+			Apply(5, latestPort5_.load(std::memory_order_relaxed));
+		}
+
+		const bool amp = (port3_ & 0x20) != 0;
+
+		for (auto& sample : samples)
+		{
+			int32_t mix = 0;
+
+			for (auto& voice : voices_)
+			{
+				if (voice.active == true)
+				{
+					mix += Sample(voice);
+				}
+			}
+
+			sample = amp == true ? static_cast<int16_t>(std::clamp(mix, -32768, 32767)) : 0;
+		}
+	}
+} // namespace meen_hw::i8080_arcade
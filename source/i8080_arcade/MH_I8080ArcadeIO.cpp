@@ -26,6 +26,7 @@ SOFTWARE.
 #include <charconv>
 #include <ctime>
 #include <cstring>
+#include <vector>
 #ifdef ENABLE_NLOHMANN_JSON
 #include <nlohmann/json.hpp>
 #else
@@ -34,9 +35,184 @@ SOFTWARE.
 
 #include "meen_hw/i8080_arcade/MH_I8080ArcadeIO.h"
 #include "meen_hw/MH_Error.h"
+#ifdef ENABLE_MH_THREADS
+#include "meen_hw/MH_WorkerPool.h"
+#endif
 
 namespace meen_hw::i8080_arcade
 {
+	// Expand each RGB332 component to 8 bits.
+	static uint32_t Rgb332ToRgb888(uint8_t colour)
+	{
+		uint32_t r = (colour >> 5) * 255 / 7;
+		uint32_t g = ((colour >> 2) & 0x07) * 255 / 7;
+		uint32_t b = (colour & 0x03) * 255 / 3;
+		return (r << 16) | (g << 8) | b;
+	}
+
+	static uint8_t Rgb888ToRgb332(uint32_t rgb)
+	{
+		return static_cast<uint8_t>(((rgb >> 16) & 0xE0) | (((rgb >> 8) & 0xE0) >> 3) | ((rgb & 0xC0) >> 6));
+	}
+
+	// Parse a named colour, a RGB332 byte or a RRGGBB triplet into both precisions.
+	static bool ParseColour(std::string_view text, uint8_t& colour, uint32_t& rgb)
+	{
+		if (text == "red")
+		{
+			colour = 0x80;
+		}
+		else if (text == "green")
+		{
+			colour = 0x14;
+		}
+		else if (text == "blue")
+		{
+			colour = 0x07;
+		}
+		else if (text == "white")
+		{
+			colour = 0xFF;
+		}
+		else if (text == "random")
+		{
+			srand(time(nullptr));
+			colour = rand() % 255;
+		}
+		else
+		{
+			uint32_t value = 0;
+			auto end = text.data() + text.size();
+			auto [ptr, errc] = std::from_chars(text.data(), end, value, 16);
+
+			// Either a RGB332 byte or a RRGGBB triplet, with no left over text
+			if (errc != std::errc() || ptr != end || (text.size() > 2 && text.size() != 6))
+			{
+				return false;
+			}
+
+			if (text.size() == 6)
+			{
+				rgb = value;
+				colour = Rgb888ToRgb332(value);
+				return true;
+			}
+
+			colour = static_cast<uint8_t>(value);
+		}
+
+		rgb = Rgb332ToRgb888(colour);
+		return true;
+	}
+
+	MH_I8080ArcadeIO::MH_I8080ArcadeIO()
+	{
+		UpdateExpandTable();
+		SelectBlitKernel();
+	}
+
+	MH_I8080ArcadeIO::~MH_I8080ArcadeIO() = default;
+
+	uint32_t MH_I8080ArcadeIO::PackPixel(uint8_t format, uint32_t rgb)
+	{
+		uint32_t r = (rgb >> 16) & 0xFF;
+		uint32_t g = (rgb >> 8) & 0xFF;
+		uint32_t b = rgb & 0xFF;
+
+		switch (format)
+		{
+			case PixelFormat::Rgb565:
+				return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+			case PixelFormat::Bgr565:
+				return ((b >> 3) << 11) | ((g >> 2) << 5) | (r >> 3);
+			case PixelFormat::Argb8888:
+				return 0xFF000000 | (r << 16) | (g << 8) | b;
+			case PixelFormat::Abgr8888:
+				return 0xFF000000 | (b << 16) | (g << 8) | r;
+			case PixelFormat::Rgba8888:
+				return (r << 24) | (g << 16) | (b << 8) | 0xFF;
+			case PixelFormat::Bgra8888:
+				return (b << 24) | (g << 16) | (r << 8) | 0xFF;
+			default:
+				assert(format <= PixelFormat::Bgra8888);
+				return 0;
+		}
+	}
+
+	void MH_I8080ArcadeIO::UpdateExpandTable()
+	{
+		auto bpp = Bpp();
+
+		// The 8bpp background is always black, the wider formats are opaque black.
+		auto buildTable = [this, bpp](ExpandTable& table, uint8_t colour, uint32_t rgb)
+		{
+			uint32_t foreground = colour;
+			uint32_t background = 0;
+
+			if (bpp == 16 || bpp == 32)
+			{
+				auto format = bpp == 16 ? format16_ : format32_;
+				foreground = PackPixel(format, rgb);
+				background = PackPixel(format, 0);
+			}
+
+			BuildExpandTable(table, bpp, scale_, foreground, background);
+		};
+
+		buildTable(expandTable_, colour_, rgb_);
+		overlayTables_.resize(overlayBands_.size());
+
+		for (size_t i = 0; i < overlayBands_.size(); i++)
+		{
+			buildTable(overlayTables_[i], overlayBands_[i].colour, overlayBands_[i].rgb);
+		}
+
+		expand_ = SelectExpandKernel(bpp, scale_);
+	}
+
+	bool MH_I8080ArcadeIO::SetOverlay(std::vector<OverlayBand>&& bands)
+	{
+		if (bands.size() > 255)
+		{
+			return false;
+		}
+
+		for (const auto& band : bands)
+		{
+			const auto& r = band.rect;
+
+			if (r.x < 0 || r.y < 0 || r.width <= 0 || r.height <= 0 || r.x + r.width > 224 || r.y + r.height > 256
+				|| ((r.x | r.y | r.width | r.height) & 0x07) != 0)
+			{
+				return false;
+			}
+		}
+
+		overlay_.clear();
+
+		if (bands.empty() == false)
+		{
+			overlay_.resize(28 * 32);
+
+			// Upright x is the source scanline, upright y counts down from the last source pixel.
+			for (size_t i = 0; i < bands.size(); i++)
+			{
+				const auto& r = bands[i].rect;
+
+				for (int tile = r.x >> 3; tile < (r.x + r.width) >> 3; tile++)
+				{
+					for (int col = (256 - r.y - r.height) >> 3; col < (256 - r.y) >> 3; col++)
+					{
+						overlay_[tile * 32 + col] = static_cast<uint8_t>(i + 1);
+					}
+				}
+			}
+		}
+
+		overlayBands_ = std::move(bands);
+		return true;
+	}
+
 	uint8_t MH_I8080ArcadeIO::ReadPort(uint16_t port)
 	{
 		if (port == 3)
@@ -72,6 +248,7 @@ namespace meen_hw::i8080_arcade
 			}
 
 			port3Byte_ = data;
+			audio_.Write(3, data);
 		}
 		else if (port == 4)
 		{
@@ -85,6 +262,7 @@ namespace meen_hw::i8080_arcade
 			}
 
 			port5Byte_ = data;
+			audio_.Write(5, data);
 		}
 		else if (port == 6)
 		{
@@ -104,7 +282,18 @@ namespace meen_hw::i8080_arcade
 	{
 		uint8_t isr = 0;
 
-		if (currTime != lastTime_)
+		if (cycleTiming_ == true)
+		{
+			if (cycles >= nextInterruptCycle_)
+			{
+				// Interrupt n fires at cycle n * cyclesPerInterrupt_, odd ones mid screen and even ones at vBlank.
+				auto interrupt = cycles / cyclesPerInterrupt_;
+				isr = interrupt & 1 ? 1 : 2;
+				nextInterrupt_ = isr == 1 ? 2 : 1;
+				nextInterruptCycle_ = (interrupt + 1) * cyclesPerInterrupt_;
+			}
+		}
+		else if (currTime != lastTime_)
 		{
 			isr = nextInterrupt_;
 
@@ -123,127 +312,441 @@ namespace meen_hw::i8080_arcade
 			lastTime_ = currTime;
 		}
 
+		if (isr == 1)
+		{
+			frame_++;
+		}
+
 		return isr;
 	}
 
-	void MH_I8080ArcadeIO::BlitVRAM(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src)
+	int MH_I8080ArcadeIO::GetScanline(uint64_t cycles) const
 	{
-		assert(dst.size() >= src.size());
+		return static_cast<int>((cycles + beamOffset_) % cyclesPerFrame_ / cyclesPerScanline_);
+	}
 
-		auto decompressVram = [src, dst, rb = rowBytes, colour = colour_](uint8_t* nextCol, bool cocktail)
+	void MH_I8080ArcadeIO::RenderAudio(std::span<int16_t> samples)
+	{
+		audio_.Render(samples);
+	}
+
+	bool MH_I8080ArcadeIO::FrameSkipped() const
+	{
+		return frame_ % skipPeriod_ >= static_cast<uint64_t>(skipPeriod_ - skipFrames_);
+	}
+
+	uint64_t MH_I8080ArcadeIO::CyclesUntilInterrupt(uint64_t cycles) const
+	{
+		if (cycleTiming_ == false || cycles >= nextInterruptCycle_)
 		{
-			auto vramStart = src.begin();
-			auto vramEnd = src.end();
-			int8_t shift = 0;
-			auto ptr = nextCol;
+			return 0;
+		}
+
+		return nextInterruptCycle_ - cycles;
+	}
 
-			while (vramStart < vramEnd)
+	void MH_I8080ArcadeIO::BlitRows(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, int firstRow, int lastRow)
+	{
+		(this->*blit_)(dst, rowBytes, src, firstRow, lastRow);
+	}
+
+	void MH_I8080ArcadeIO::SelectBlitKernel()
+	{
+		// Indexed by upright, scaled and overlay.
+		static constexpr BlitKernel kernels[2][2][2] =
+		{
+			{
+				{ &MH_I8080ArcadeIO::BlitRowsT<false, false, false>, &MH_I8080ArcadeIO::BlitRowsT<false, false, true> },
+				{ &MH_I8080ArcadeIO::BlitRowsT<false, true, false>, &MH_I8080ArcadeIO::BlitRowsT<false, true, true> }
+			},
 			{
-				//Decompress the vram from 1bpp to 8bpp.
-				*ptr = ((*vramStart >> shift) & 0x01) * colour;
-				//Cycle the shift value between 0-7.
-				shift = ++shift & 0x07;
-				//Move to the next vram byte if we have done a full cycle.
-				vramStart += shift == 0;
+				{ &MH_I8080ArcadeIO::BlitRowsT<true, false, false>, &MH_I8080ArcadeIO::BlitRowsT<true, false, true> },
+				{ &MH_I8080ArcadeIO::BlitRowsT<true, true, false>, &MH_I8080ArcadeIO::BlitRowsT<true, true, true> }
+			}
+		};
+
+		blit_ = kernels[(blitMode_ & BlitFlags::Upright) != 0][scale_ > 1][overlay_.empty() == false];
+	}
+
+	template<bool Upright, bool Scaled, bool Overlay>
+	void MH_I8080ArcadeIO::BlitRowsT(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, int firstRow, int lastRow)
+	{
+		static constexpr int srcWidth = 32;
+		const int entryBytes = expandTable_.entryBytes;
+		const int scale = Scaled ? scale_ : 1;
+		const auto expand = expand_;
 
-				if(cocktail == true)
+		// Duplicate a finished scanline segment into the remaining scale - 1 scanlines below it.
+		auto replicate = [rowBytes, scale](uint8_t* row, int rowLength)
+		{
+			if constexpr (Scaled)
+			{
+				for (int i = 1; i < scale; i++)
 				{
-					if (++ptr - nextCol >= 256)
-					{
-						nextCol += rb;
-						ptr = nextCol;
-					}
+					std::copy_n(row, rowLength, row + i * rowBytes);
 				}
-				else
+			}
+		};
+
+		// A span of compressed bytes that share the same overlay colour.
+		struct Run
+		{
+			int first;
+			int count;
+			const ExpandTable* table;
+		};
+
+		Run runs[32];
+		int runCount = 0;
+
+		// Split count compressed bytes into runs of the same overlay colour, each gel entry is stride bytes apart.
+		auto buildRuns = [&](const uint8_t* gel, int stride, int count)
+		{
+			runCount = 0;
+
+			for (int i = 0; i < count; i++)
+			{
+				if (i == 0 || gel[i * stride] != gel[(i - 1) * stride])
 				{
-					//If we are not at the first row, move to the previous row, otherwise move to the next column.
-					ptr - rb < dst.data() ? ptr = ++nextCol : ptr -= rb;
+					auto index = gel[i * stride];
+					runs[runCount++] = { i, 0, index == 0 ? &expandTable_ : &overlayTables_[index - 1] };
 				}
+
+				runs[runCount - 1].count++;
 			}
 		};
 
-		switch (blitMode_)
+		auto expandRow = [&](uint8_t* d, const uint8_t* s, int count)
 		{
-			case BlitFlags::Upright:
+			if constexpr (Overlay)
 			{
-				static constexpr int srcWidth = 32;
-				static constexpr int srcWidthMinus1 = srcWidth - 1;
-				// Need to skip an additional 7 rows once the vertical sampling is complete.
-				static constexpr int srcRowSkip = srcWidth * 7;
+				for (int i = 0; i < runCount; i++)
+				{
+					expand(d + runs[i].first * entryBytes, s + runs[i].first, runs[i].count, *runs[i].table);
+				}
+			}
+			else
+			{
+				expand(d, s, count, expandTable_);
+			}
+		};
 
-				auto begin = src.begin();
-				auto end = src.end();
-				auto start = dst.data() + rowBytes * (256 - 1);
-				auto ptr = start;
+		if constexpr (Upright)
+		{
+			// Rows are rotated in tiles of 8, each tile is one compressed byte of each destination scanline.
+			const int firstTile = firstRow >> 3;
+			const int tileCount = ((lastRow + 7) >> 3) - firstTile;
+			uint8_t rows[8][32];
+			assert(firstTile + tileCount <= 32);
 
-				while (begin < end)
+			// Each source byte column is rotated into 8 destination scanlines (8 * scale when scaled), bottom up.
+			for (int col = 0; col < srcWidth; col++)
+			{
+				auto s = src.data() + firstTile * srcWidth * 8 + col;
+
+				for (int t = 0; t < tileCount; t++, s += srcWidth * 8)
 				{
-					for (int i = 0; i < 8; i++)
-					{
-						uint8_t byte = 0;
+					uint64_t tile = 0;
 
-						// Transpose the compressed pixels (sample from 8 pixels vertically)
-						for (int j = 0; j < 8; j++)
-						{
-							byte |= (((begin[j * srcWidth] >> i) & 0x01) << j);
-						}
+					// Pack 8 vertically adjacent source bytes, then transpose them into 8 horizontal destination bytes
+					for (int j = 0; j < 8; j++)
+					{
+						tile |= static_cast<uint64_t>(s[j * srcWidth]) << (j * 8);
+					}
 
-						*ptr = byte;
+					tile = Transpose8x8(tile);
 
-						// Move to the previous row, else the next column
-						ptr - rowBytes >= dst.data() ? ptr -= rowBytes : ptr = ++start;
+					for (int i = 0; i < 8; i++)
+					{
+						rows[i][t] = static_cast<uint8_t>(tile >> (i * 8));
 					}
+				}
 
-					begin++;
+				// Each tile of this column may sit under a different overlay band.
+				if constexpr (Overlay)
+				{
+					buildRuns(overlay_.data() + firstTile * 32 + col, 32, tileCount);
+				}
 
-					// Since we sample 8 vertical pixels we need to skip another 7 rows when we get to the end of the current row.
-					// TODO: mem pool frames need to be 32 bit aligned, then we don't have to subtract src, ie; just for (begin & (width_ - 1)) == 0
-					begin += (((begin - src.begin() & srcWidthMinus1) == 0) * srcRowSkip);
+				for (int i = 0; i < 8; i++)
+				{
+					auto row = dst.data() + rowBytes * (255 - col * 8 - i) * scale + firstTile * entryBytes;
+					expandRow(row, rows[i], tileCount);
+					replicate(row, tileCount * entryBytes);
 				}
-				break;
 			}
-			case BlitFlags::Native:
+		}
+		else
+		{
+			auto s = src.data() + firstRow * srcWidth;
+			auto d = dst.data() + firstRow * rowBytes * scale;
+			const int rowLength = srcWidth * entryBytes;
+
+			// A tightly packed destination is one contiguous expansion.
+			if (Scaled == false && Overlay == false && rowBytes == rowLength)
 			{
-				if(rowBytes == 32)
-				{
-					std::copy(src.begin(), src.end(), dst.begin());
-				}
-				else
-				{
-					auto d = dst.begin();;
-					auto s = src.begin();
+				expand(d, s, (lastRow - firstRow) * srcWidth, expandTable_);
+				return;
+			}
 
-					// copy out each scanline
-					while(s < src.end())
+			// expand each scanline
+			for (int row = firstRow; row < lastRow; row++)
+			{
+				// Every scanline of a tile sits under the same overlay bands.
+				if constexpr (Overlay)
+				{
+					if (row == firstRow || (row & 0x07) == 0)
 					{
-						std::copy_n(s, 32, d);
-						d += rowBytes;
-						s += 32;
+						buildRuns(overlay_.data() + (row >> 3) * 32, 1, srcWidth);
 					}
 				}
-				break;
+
+				expandRow(d, s, srcWidth);
+				replicate(d, rowLength);
+				d += rowBytes * scale;
+				s += srcWidth;
 			}
+		}
+	}
+
+	MH_Rect MH_I8080ArcadeIO::RowsToRect(int firstRow, int lastRow) const
+	{
+		if (blitMode_ & BlitFlags::Upright)
+		{
+			// Source rows are destination columns, rounded out to the rotated tiles.
+			firstRow &= ~0x07;
+			lastRow = std::min((lastRow + 7) & ~0x07, 224);
+			return { firstRow * scale_, 0, (lastRow - firstRow) * scale_, GetVRAMHeight() };
+		}
+
+		return { 0, firstRow * scale_, GetVRAMWidth(), (lastRow - firstRow) * scale_ };
+	}
+
+	int MH_I8080ArcadeIO::Bpp() const
+	{
+		switch (blitMode_ & BlitFlags::ColourMask)
+		{
 			case BlitFlags::Rgb332:
+				return 8;
+			case BlitFlags::Rgb16:
+				return 16;
+			case BlitFlags::Rgb32:
+				return 32;
+			default:
+				return 1;
+		}
+	}
+
+	void MH_I8080ArcadeIO::BlitVRAM(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src)
+	{
+		assert(dst.size() >= src.size());
+
+		if (FrameSkipped() == true)
+		{
+			return;
+		}
+
+		BlitRows(dst, rowBytes, src, 0, static_cast<int>(src.size() / 32));
+	}
+
+	void MH_I8080ArcadeIO::BlitVRAMParallel(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, const MH_BlitExecutor& executor)
+	{
+		assert(dst.size() >= src.size());
+
+		if (FrameSkipped() == true)
+		{
+			return;
+		}
+
+		// Bands are whole 8 row tiles so that upright bands never share a destination byte.
+		const int tiles = static_cast<int>(src.size() / (32 * 8));
+		int bandCount = 1;
+
+		const std::function<void(int)> blitBand = [&](int band)
+		{
+			BlitRows(dst, rowBytes, src, tiles * band / bandCount * 8, tiles * (band + 1) / bandCount * 8);
+		};
+
+		if (executor)
+		{
+			bandCount = (tiles + bandTiles_ - 1) / bandTiles_;
+			executor(bandCount, blitBand);
+		}
+		else
+		{
+#ifdef ENABLE_MH_THREADS
+			if (workerPool_ == nullptr)
 			{
-				decompressVram(dst.data(), true);
-				break;
+				workerPool_ = std::make_unique<MH_WorkerPool>(std::max(static_cast<int>(std::thread::hardware_concurrency()) - 1, 0));
 			}
-			case BlitFlags::Upright8bpp:
+
+			bandCount = std::min(workerPool_->Size(), tiles);
+			workerPool_->Run(bandCount, blitBand);
+#else
+			blitBand(0);
+#endif
+		}
+	}
+
+	MH_Rect MH_I8080ArcadeIO::BlitVRAMHalf(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, uint8_t isr)
+	{
+		assert(dst.size() >= src.size());
+
+		if ((isr != 1 && isr != 2) || FrameSkipped() == true)
+		{
+			return {};
+		}
+
+		// Split where the raster model's beam is at interrupt 1, in whole upright tiles so the halves never share a destination byte.
+		const int srcRows = static_cast<int>(src.size() / 32);
+		const int split = std::min(isr1Rows_, srcRows);
+		const int firstRow = isr == 1 ? 0 : split;
+		const int lastRow = isr == 1 ? split : srcRows;
+
+		BlitRows(dst, rowBytes, src, firstRow, lastRow);
+		return RowsToRect(firstRow, lastRow);
+	}
+
+	MH_Rect MH_I8080ArcadeIO::BlitVRAMToBeam(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, uint64_t cycles)
+	{
+		assert(dst.size() >= src.size());
+
+		const int srcRows = static_cast<int>(src.size() / 32);
+		const auto frame = (cycles + beamOffset_) / cyclesPerFrame_;
+		auto row = std::min(GetScanline(cycles), srcRows);
+		auto first = beamRow_;
+		// The first row of the previous frame's tail, srcRows when there is none.
+		auto tail = srcRows;
+
+		// Upright rows are packed into the same destination bytes 8 at a time, only blit whole tiles.
+		if (blitMode_ & BlitFlags::Upright)
+		{
+			row &= ~0x07;
+		}
+
+		if (frame != beamFrame_)
+		{
+			// The beam has moved on to a new frame, finish the rows it drew of the previous one.
+			if (beamRow_ < srcRows && FrameSkipped() == false)
 			{
-				decompressVram(dst.data() + rowBytes * (256 - 1), false);
-				break;
+				BlitRows(dst, rowBytes, src, beamRow_, srcRows);
+				tail = beamRow_;
 			}
-			default:
+
+			beamFrame_ = frame;
+			first = 0;
+		}
+
+		beamRow_ = std::max(row, first);
+
+		if (row <= first || FrameSkipped() == true)
+		{
+			return tail < srcRows ? RowsToRect(tail, srcRows) : MH_Rect{};
+		}
+
+		BlitRows(dst, rowBytes, src, first, row);
+		return tail < srcRows ? RowsToRect(0, srcRows) : RowsToRect(first, row);
+	}
+
+	int MH_I8080ArcadeIO::BlitVRAMIncremental(std::span<uint8_t> dst, int rowBytes, std::span<uint8_t> src, std::span<MH_Rect> dirtyRects)
+	{
+		assert(dst.size() >= src.size());
+
+		// The previous vram is left untouched, the next blit compares against what dst actually holds.
+		if (FrameSkipped() == true)
+		{
+			return 0;
+		}
+
+		static constexpr int srcWidth = 32;
+		const int srcRows = static_cast<int>(src.size() / srcWidth);
+		int rectCount = 0;
+
+		// Blit the dirty rows and record the destination region they cover.
+		auto blitDirty = [&](int firstRow, int lastRow)
+		{
+			BlitRows(dst, rowBytes, src, firstRow, lastRow);
+
+			if (dirtyRects.empty() == true)
+			{
+				return;
+			}
+
+			auto rect = RowsToRect(firstRow, lastRow);
+
+			if (rectCount < static_cast<int>(dirtyRects.size()))
+			{
+				dirtyRects[rectCount++] = rect;
+			}
+			else
 			{
-				// todo: log invalid blit mode
-				assert(blitMode_ == BltFlags::Upright || blitMode_ == BltFlags::Native || blitMode_ == BlitFlags::Rgb332 || blitMode_ == BlitFlags::Upright8bpp);
+				// Out of rects, grow the last one to cover this region as well.
+				auto& last = dirtyRects[rectCount - 1];
+				rect.width = std::max(last.x + last.width, rect.x + rect.width) - std::min(last.x, rect.x);
+				rect.height = std::max(last.y + last.height, rect.y + rect.height) - std::min(last.y, rect.y);
+				rect.x = std::min(last.x, rect.x);
+				rect.y = std::min(last.y, rect.y);
+				last = rect;
 			}
+		};
+
+		// Nothing to compare against, everything is dirty.
+		if (prevVRAM_.size() != src.size())
+		{
+			prevVRAM_.assign(src.begin(), src.end());
+			blitDirty(0, srcRows);
+			return rectCount;
 		}
+
+		// Upright blits rotate 8 rows at a time, so compare in the same granularity.
+		const int stride = blitMode_ & BlitFlags::Upright ? 8 : 1;
+		const int strideBytes = stride * srcWidth;
+		int firstDirty = -1;
+
+		for (int row = 0; row < srcRows; row += stride)
+		{
+			auto curr = src.data() + row * srcWidth;
+			auto prev = prevVRAM_.data() + row * srcWidth;
+			uint64_t diff = 0;
+
+			for (int i = 0; i < strideBytes; i += sizeof(uint64_t))
+			{
+				uint64_t c;
+				uint64_t p;
+				memcpy(&c, curr + i, sizeof(uint64_t));
+				memcpy(&p, prev + i, sizeof(uint64_t));
+				diff |= c ^ p;
+			}
+
+			if (diff != 0)
+			{
+				std::copy_n(curr, strideBytes, prev);
+
+				if (firstDirty < 0)
+				{
+					firstDirty = row;
+				}
+			}
+			else if (firstDirty >= 0)
+			{
+				blitDirty(firstDirty, row);
+				firstDirty = -1;
+			}
+		}
+
+		if (firstDirty >= 0)
+		{
+			blitDirty(firstDirty, srcRows);
+		}
+
+		return rectCount;
 	}
 
 	std::error_code MH_I8080ArcadeIO::SetOptions(const char* jsonOptions)
 	{
 		auto err = make_error_code(errc::no_error);
+		// The expansion table needs to be rebuilt when the colour or bpp changes.
+		auto rebuildTable = false;
 #ifdef ENABLE_NLOHMANN_JSON
 		auto options = nlohmann::json::parse(jsonOptions, nullptr, false);
 
@@ -275,16 +778,28 @@ namespace meen_hw::i8080_arcade
 #else
 				auto value = kv.value().as<uint8_t>();
 #endif
+				rebuildTable = true;
+
 				switch (value)
 				{
 					case 1:
 					{
-						blitMode_ &= ~BlitFlags::Rgb332;
+						blitMode_ &= ~BlitFlags::ColourMask;
 						break;
 					}
 					case 8:
 					{
-						blitMode_ |= BlitFlags::Rgb332;
+						blitMode_ = (blitMode_ & ~BlitFlags::ColourMask) | BlitFlags::Rgb332;
+						break;
+					}
+					case 16:
+					{
+						blitMode_ = (blitMode_ & ~BlitFlags::ColourMask) | BlitFlags::Rgb16;
+						break;
+					}
+					case 32:
+					{
+						blitMode_ = (blitMode_ & ~BlitFlags::ColourMask) | BlitFlags::Rgb32;
 						break;
 					}
 					default:
@@ -301,40 +816,128 @@ namespace meen_hw::i8080_arcade
 #else
 				auto colour = kv.value().as<std::string_view>();
 #endif
-				auto [ptr, errc] = std::from_chars(colour.data(), colour.data() + colour.size(), colour_, 16);
+				rebuildTable = true;
 
-				if (errc != std::errc())
+				if (ParseColour(colour, colour_, rgb_) == false)
 				{
-					if (colour == "red")
-					{
-						colour_ = 0x80;
-					}
-					else if (colour == "green")
-					{
-						colour_ = 0x14;
-					}
-					else if (colour == "blue")
+					err = meen_hw::make_error_code(errc::colour);
+				}
+			}
+			else if (key == "format")
+			{
+#ifdef ENABLE_NLOHMANN_JSON
+				auto format = val.get<std::string_view>();
+#else
+				auto format = kv.value().as<std::string_view>();
+#endif
+				rebuildTable = true;
+
+				if (format == "rgb565")
+				{
+					format16_ = PixelFormat::Rgb565;
+				}
+				else if (format == "bgr565")
+				{
+					format16_ = PixelFormat::Bgr565;
+				}
+				else if (format == "argb8888")
+				{
+					format32_ = PixelFormat::Argb8888;
+				}
+				else if (format == "abgr8888")
+				{
+					format32_ = PixelFormat::Abgr8888;
+				}
+				else if (format == "rgba8888")
+				{
+					format32_ = PixelFormat::Rgba8888;
+				}
+				else if (format == "bgra8888")
+				{
+					format32_ = PixelFormat::Bgra8888;
+				}
+				else
+				{
+					err = meen_hw::make_error_code(errc::format);
+				}
+			}
+			else if (key == "overlay")
+			{
+				std::vector<OverlayBand> bands;
+				auto valid = true;
+				rebuildTable = true;
+
+				// Parse a single user defined band, the colour defaults to white.
+				auto addBand = [&](int x, int y, int width, int height, std::string_view colour)
+				{
+					OverlayBand band{ { x, y, width, height }, 0, 0 };
+					valid = valid && ParseColour(colour, band.colour, band.rgb);
+					bands.push_back(band);
+				};
+#ifdef ENABLE_NLOHMANN_JSON
+				if (val.is_string() == true)
+				{
+					auto preset = val.get<std::string_view>();
+#else
+				if (kv.value().is<const char*>() == true)
+				{
+					auto preset = kv.value().as<std::string_view>();
+#endif
+					if (preset == "invaders")
 					{
-						colour_ = 0x07;
+						// The Space Invaders cellophane: red over the ufo, green over the player, shields and lives.
+						addBand(0, 32, 224, 32, "FF0000");
+						addBand(0, 184, 224, 56, "00FF00");
+						addBand(16, 240, 120, 16, "00FF00");
 					}
-					else if (colour == "white")
+					else if (preset != "none")
 					{
-						colour_ = 0xFF;
+						valid = false;
 					}
-					else if (colour == "random")
+				}
+#ifdef ENABLE_NLOHMANN_JSON
+				else if (val.is_array() == true)
+				{
+					for (const auto& b : val)
 					{
-						srand(time(nullptr));
-						colour_ = rand() % 255;
+						addBand(b.value("x", 0), b.value("y", 0), b.value("width", 0), b.value("height", 0), b.value("colour", std::string("white")));
 					}
-					else
+				}
+#else
+				else if (kv.value().is<JsonArrayConst>() == true)
+				{
+					for (auto b : kv.value().as<JsonArrayConst>())
 					{
-						err = meen_hw::make_error_code(errc::colour);
+						addBand(b["x"] | 0, b["y"] | 0, b["width"] | 0, b["height"] | 0, b["colour"] | "white");
 					}
 				}
-				else if (*ptr != '\0')
+#endif
+				else
 				{
-					// we parsed something but there is still left over text
-					err = meen_hw::make_error_code(errc::colour);
+					valid = false;
+				}
+
+				if (valid == false || SetOverlay(std::move(bands)) == false)
+				{
+					err = meen_hw::make_error_code(errc::overlay);
+				}
+			}
+			else if (key == "scale")
+			{
+#ifdef ENABLE_NLOHMANN_JSON
+				auto value = val.get<int>();
+#else
+				auto value = kv.value().as<int>();
+#endif
+				rebuildTable = true;
+
+				if (value >= 1 && value <= 4)
+				{
+					scale_ = static_cast<uint8_t>(value);
+				}
+				else
+				{
+					err = meen_hw::make_error_code(errc::scale);
 				}
 			}
 			else if(key == "orientation")
@@ -358,22 +961,99 @@ namespace meen_hw::i8080_arcade
 					err = meen_hw::make_error_code(errc::orientation);
 				}
 			}
+			else if(key == "timing")
+			{
+#ifdef ENABLE_NLOHMANN_JSON
+				auto timing = val.get<std::string>();
+#else
+				auto timing = kv.value().as<std::string>();
+#endif
+
+				if (timing == "cycles" || timing == "time")
+				{
+					cycleTiming_ = timing == "cycles";
+					nextInterruptCycle_ = cyclesPerInterrupt_;
+				}
+				else
+				{
+					err = meen_hw::make_error_code(errc::timing);
+				}
+			}
+			else if(key == "frame-skip")
+			{
+				int skip = -1;
+				int period = -1;
+#ifdef ENABLE_NLOHMANN_JSON
+				if (val.is_array() == true && val.size() == 2 && val[0].is_number_integer() == true && val[1].is_number_integer() == true)
+				{
+					skip = val[0].get<int>();
+					period = val[1].get<int>();
+				}
+#else
+				auto skipPeriod = kv.value().as<JsonArrayConst>();
+
+				if (skipPeriod.size() == 2 && skipPeriod[0].is<int>() == true && skipPeriod[1].is<int>() == true)
+				{
+					skip = skipPeriod[0].as<int>();
+					period = skipPeriod[1].as<int>();
+				}
+#endif
+				if (skip >= 0 && skip < period && period <= 255)
+				{
+					skipFrames_ = static_cast<uint8_t>(skip);
+					skipPeriod_ = static_cast<uint8_t>(period);
+					frame_ = 0;
+				}
+				else
+				{
+					err = meen_hw::make_error_code(errc::frame_skip);
+				}
+			}
+			else if(key == "audio-rate")
+			{
+#ifdef ENABLE_NLOHMANN_JSON
+				auto rate = val.is_number_integer() == true ? val.get<int>() : 0;
+#else
+				auto rate = kv.value().is<int>() == true ? kv.value().as<int>() : 0;
+#endif
+
+				if (rate >= 8000 && rate <= 192000)
+				{
+					audio_.SetSampleRate(static_cast<uint32_t>(rate));
+				}
+				else
+				{
+					err = meen_hw::make_error_code(errc::audio_rate);
+				}
+			}
 			else
 			{
 				//todo: log unknown option
 			}
 		}
 
+		// The destination layout may have changed, the next incremental blit must be a full blit.
+		prevVRAM_.clear();
+		beamFrame_ = 0;
+		beamRow_ = 0;
+
+		if (rebuildTable == true)
+		{
+			UpdateExpandTable();
+		}
+
+		SelectBlitKernel();
+
 		return err;
 	}
 
 	int MH_I8080ArcadeIO::GetVRAMWidth() const
 	{
-		return blitMode_ & BlitFlags::Upright ? 224 : 256;
+		return (blitMode_ & BlitFlags::Upright ? 224 : 256) * scale_;
 	}
 
 	int MH_I8080ArcadeIO::GetVRAMHeight() const
 	{
-		return blitMode_ & BlitFlags::Upright ? 256 : 224;
+		return (blitMode_ & BlitFlags::Upright ? 256 : 224) * scale_;
 	}
 } // namespace meen_hw::i8080_arcade
\ No newline at end of file
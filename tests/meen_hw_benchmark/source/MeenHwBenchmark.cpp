@@ -0,0 +1,873 @@
+/*
+Copyright (c) 2021-2024 Nicolas Beddows <nicolas.beddows@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "meen_hw/MH_Factory.h"
+#include "meen_hw/MH_FramePacer.h"
+#include "meen_hw/MH_ResourcePool.h"
+#include "meen_hw/MH_RingBuffer.h"
+#include "meen_hw/MH_TripleBuffer.h"
+#include "meen_hw/MH_WorkerPool.h"
+
+namespace meen_hw::benchmarks
+{
+	/** Time a callable
+
+		Runs fn for the given number of iterations a few times over.
+
+		@return		The best average time of a single call in nanoseconds.
+	*/
+	template<class Fn>
+	static double Measure(Fn&& fn, int iterations = 1000)
+	{
+		auto best = std::numeric_limits<double>::max();
+
+		for (int sample = 0; sample < 5; sample++)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			for (int i = 0; i < iterations; i++)
+			{
+				fn();
+			}
+
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count() / iterations);
+		}
+
+		return best;
+	}
+
+	static void FillVRAM(std::vector<uint8_t>& vram)
+	{
+		uint32_t seed = 0x12345678;
+
+		for (auto& byte : vram)
+		{
+			seed = seed * 1664525 + 1013904223;
+			byte = static_cast<uint8_t>(seed >> 24);
+		}
+	}
+
+	/** Hammer a resource pool from several threads
+
+		Each thread repeatedly acquires a resource and immediately returns it.
+
+		@return		The drop rate in percent and the average acquire + release time in nanoseconds.
+	*/
+	template<class Pool>
+	static std::pair<double, double> HammerPool(Pool& pool, int threadCount, int iterations)
+	{
+		std::atomic<int64_t> drops{};
+		std::atomic<int64_t> latency{};
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&]
+			{
+				int64_t threadDrops = 0;
+				auto start = std::chrono::steady_clock::now();
+
+				for (int i = 0; i < iterations; i++)
+				{
+					auto resource = pool.GetResource();
+					threadDrops += resource == nullptr;
+				}
+
+				std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+				drops += threadDrops;
+				latency += static_cast<int64_t>(elapsed.count());
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		const double total = static_cast<double>(threadCount) * iterations;
+		return { drops * 100.0 / total, latency / total };
+	}
+
+	static void ResourcePools()
+	{
+		constexpr int resourceCount = 8;
+		constexpr int iterations = 200000;
+		std::vector<int> resources(resourceCount);
+
+		printf("Resource pool acquire/release (%u hardware threads)\n", std::thread::hardware_concurrency());
+		printf("%-10s %-12s %12s %16s\n", "threads", "pool", "drops (%)", "round trip (ns)");
+
+		for (int threads = 1; threads <= 8; threads *= 2)
+		{
+			// The resources are owned by the vector, the pool must not delete them.
+			auto noDelete = [](int*) {};
+			MH_ResourcePool<int, decltype(noDelete)> mutexPool;
+			MH_ResourcePool<int, decltype(noDelete)> magazinePool(2);
+			MH_LockFreeResourcePool<int, decltype(noDelete)> lockFreePool(resourceCount);
+			MH_HandleResourcePool<int, decltype(noDelete)> handlePool(resourceCount);
+			MH_FixedResourcePool<int, resourceCount> fixedPool;
+
+			for (auto& resource : resources)
+			{
+				mutexPool.AddResource(&resource);
+				magazinePool.AddResource(&resource);
+				lockFreePool.AddResource(&resource);
+				handlePool.AddResource(&resource);
+			}
+
+			auto [mutexDrops, mutexLatency] = HammerPool(mutexPool, threads, iterations);
+			auto [magazineDrops, magazineLatency] = HammerPool(magazinePool, threads, iterations);
+			auto [lockFreeDrops, lockFreeLatency] = HammerPool(lockFreePool, threads, iterations);
+			auto [handleDrops, handleLatency] = HammerPool(handlePool, threads, iterations);
+			auto [fixedDrops, fixedLatency] = HammerPool(fixedPool, threads, iterations);
+
+			printf("%-10d %-12s %12.3f %16.1f\n", threads, "mutex", mutexDrops, mutexLatency);
+			printf("%-10d %-12s %12.3f %16.1f\n", threads, "magazine", magazineDrops, magazineLatency);
+			printf("%-10d %-12s %12.3f %16.1f\n", threads, "lock-free", lockFreeDrops, lockFreeLatency);
+			printf("%-10d %-12s %12.3f %16.1f\n", threads, "handle", handleDrops, handleLatency);
+			printf("%-10d %-12s %12.3f %16.1f\n", threads, "fixed", fixedDrops, fixedLatency);
+		}
+
+		printf("\n");
+	}
+
+	/** Contend a lock from several threads
+
+		Each thread repeatedly takes the lock, does a pool sized amount of work
+		(a list push and pop) and releases it, timing every acquire + release.
+
+		@return		The p50 and p99 lock round trip in nanoseconds.
+	*/
+	template<class Lock>
+	static std::pair<double, double> ContendLock(int threadCount, int iterations)
+	{
+		Lock lock;
+		std::deque<int> shared(8);
+		std::vector<std::vector<float>> samples(threadCount);
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&, t]
+			{
+				auto& threadSamples = samples[t];
+				threadSamples.reserve(iterations);
+
+				for (int i = 0; i < iterations; i++)
+				{
+					auto start = std::chrono::steady_clock::now();
+
+					{
+						std::lock_guard<Lock> lg(lock);
+						shared.push_back(shared.front());
+						shared.pop_front();
+					}
+
+					std::chrono::duration<float, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+					threadSamples.push_back(elapsed.count());
+				}
+			});
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		std::vector<float> all;
+
+		for (auto& threadSamples : samples)
+		{
+			all.insert(all.end(), threadSamples.begin(), threadSamples.end());
+		}
+
+		auto percentile = [&all](double p)
+		{
+			auto nth = all.begin() + static_cast<size_t>(p * (all.size() - 1));
+			std::nth_element(all.begin(), nth, all.end());
+			return static_cast<double>(*nth);
+		};
+
+		return { percentile(0.5), percentile(0.99) };
+	}
+
+	static void LockContention()
+	{
+		constexpr int iterations = 100000;
+
+		printf("Lock contention (%u hardware threads)\n", std::thread::hardware_concurrency());
+		printf("%-10s %-12s %12s %12s\n", "threads", "lock", "p50 (ns)", "p99 (ns)");
+
+		for (int threads = 2; threads <= 8; threads *= 2)
+		{
+			auto [mutexP50, mutexP99] = ContendLock<std::mutex>(threads, iterations);
+			auto [adaptiveP50, adaptiveP99] = ContendLock<MH_AdaptiveMutex>(threads, iterations);
+			auto [spinP50, spinP99] = ContendLock<MH_SpinLock>(threads, iterations);
+
+			printf("%-10d %-12s %12.1f %12.1f\n", threads, "std::mutex", mutexP50, mutexP99);
+			printf("%-10d %-12s %12.1f %12.1f\n", threads, "adaptive", adaptiveP50, adaptiveP99);
+			printf("%-10d %-12s %12.1f %12.1f\n", threads, "spin", spinP50, spinP99);
+		}
+
+		printf("\n");
+	}
+
+	/** A frame handed from the producer to the consumer */
+	struct Frame
+	{
+		std::chrono::steady_clock::time_point published;
+		std::vector<uint8_t> pixels;
+
+		explicit Frame(size_t size = 256 * 224)
+			: pixels(size)
+		{
+
+		}
+	};
+
+	/** Frame handoff statistics */
+	struct Handoff
+	{
+		double latency;		/**< Average time from publish to the consumer taking the frame in nanoseconds. */
+		int presented;		/**< Frames taken by the consumer. */
+		int dropped;		/**< Frames the producer could not publish. */
+	};
+
+	/** Hand frames to a consumer that only presents the newest via a triple buffer */
+	static Handoff HandoffTripleBuffer(int frameCount)
+	{
+		MH_TripleBuffer<Frame> frames;
+		std::atomic<bool> done{};
+		Handoff result{};
+		double latency = 0;
+
+		std::thread consumer([&]
+		{
+			while (true)
+			{
+				auto finished = done.load();
+
+				if (frames.Acquire() == true)
+				{
+					latency += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - frames.Front().published).count();
+					result.presented++;
+				}
+				else if (finished == true)
+				{
+					break;
+				}
+			}
+		});
+
+		for (int i = 0; i < frameCount; i++)
+		{
+			auto& frame = frames.Back();
+			std::fill(frame.pixels.begin(), frame.pixels.end(), static_cast<uint8_t>(i));
+			frame.published = std::chrono::steady_clock::now();
+			frames.Publish();
+			std::this_thread::yield();
+		}
+
+		done = true;
+		consumer.join();
+		result.latency = latency / std::max(result.presented, 1);
+		return result;
+	}
+
+	/** Hand frames to a consumer that only presents the newest via a resource pool and a queue */
+	static Handoff HandoffResourcePool(int frameCount)
+	{
+		MH_ResourcePool<Frame> pool;
+		std::mutex queueMutex;
+		std::deque<MH_ResourcePool<Frame>::ResourcePtr> queue;
+		std::atomic<bool> done{};
+		Handoff result{};
+		double latency = 0;
+
+		for (int i = 0; i < 3; i++)
+		{
+			pool.AddResource(new Frame());
+		}
+
+		std::thread consumer([&]
+		{
+			MH_ResourcePool<Frame>::ResourcePtr front;
+
+			while (true)
+			{
+				MH_ResourcePool<Frame>::ResourcePtr newest;
+				auto finished = done.load();
+
+				{
+					std::lock_guard<std::mutex> lg(queueMutex);
+
+					// Stale frames go back to the pool as they are replaced
+					while (queue.empty() == false)
+					{
+						newest = std::move(queue.front());
+						queue.pop_front();
+					}
+				}
+
+				if (newest != nullptr)
+				{
+					latency += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - newest->published).count();
+					result.presented++;
+					front = std::move(newest);
+				}
+				else if (finished == true)
+				{
+					break;
+				}
+			}
+		});
+
+		for (int i = 0; i < frameCount; i++)
+		{
+			auto frame = pool.GetResource();
+
+			if (frame == nullptr)
+			{
+				result.dropped++;
+				std::this_thread::yield();
+				continue;
+			}
+
+			std::fill(frame->pixels.begin(), frame->pixels.end(), static_cast<uint8_t>(i));
+			frame->published = std::chrono::steady_clock::now();
+
+			{
+				std::lock_guard<std::mutex> lg(queueMutex);
+				queue.push_back(std::move(frame));
+			}
+
+			std::this_thread::yield();
+		}
+
+		done = true;
+		consumer.join();
+		result.latency = latency / std::max(result.presented, 1);
+		return result;
+	}
+
+	static void FrameHandoff()
+	{
+		constexpr int frameCount = 20000;
+
+		printf("Newest frame handoff, %d frames (%u hardware threads)\n", frameCount, std::thread::hardware_concurrency());
+		printf("%-14s %14s %12s %12s\n", "exchange", "latency (ns)", "presented", "dropped");
+
+		auto triple = HandoffTripleBuffer(frameCount);
+		auto pool = HandoffResourcePool(frameCount);
+
+		printf("%-14s %14.0f %12d %12d\n", "triple buffer", triple.latency, triple.presented, triple.dropped);
+		printf("%-14s %14.0f %12d %12d\n", "pool + queue", pool.latency, pool.presented, pool.dropped);
+		printf("\n");
+	}
+
+	/** Stream values from a producer thread to a consumer thread
+
+		@param	push	Pushes up to batch values from the span, returns the number pushed.
+		@param	pop		Pops up to batch values into the span, returns the number popped.
+
+		@return			Millions of values per second.
+	*/
+	template<class T, class Push, class Pop>
+	static double Stream(Push&& push, Pop&& pop, uint32_t batch, uint32_t count)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		std::thread consumer([&]
+		{
+			std::vector<T> values(batch);
+
+			for (uint32_t received = 0; received < count;)
+			{
+				auto popped = pop(std::span<T>(values));
+				received += popped;
+
+				if (popped == 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		std::vector<T> values(batch);
+
+		for (uint32_t sent = 0; sent < count;)
+		{
+			auto pushed = push(std::span<const T>(values.data(), std::min(batch, count - sent)));
+			sent += pushed;
+
+			if (pushed == 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		consumer.join();
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+		return count / elapsed.count();
+	}
+
+	/** Compare a MH_RingBuffer with a mutex protected deque */
+	template<class T>
+	static void StreamValues(const char* name, uint32_t batch, uint32_t count)
+	{
+		auto ring = std::make_unique<MH_RingBuffer<T, 1024>>();
+
+		auto ringRate = Stream<T>([&ring](std::span<const T> values) { return ring->Push(values); },
+			[&ring](std::span<T> values) { return ring->Pop(values); }, batch, count);
+
+		std::mutex mutex;
+		std::deque<T> queue;
+
+		auto queueRate = Stream<T>([&](std::span<const T> values)
+		{
+			std::lock_guard<std::mutex> lg(mutex);
+			auto pushed = std::min<size_t>(values.size(), 1024 - queue.size());
+			queue.insert(queue.end(), values.begin(), values.begin() + pushed);
+			return static_cast<uint32_t>(pushed);
+		},
+		[&](std::span<T> values)
+		{
+			std::lock_guard<std::mutex> lg(mutex);
+			auto popped = std::min(values.size(), queue.size());
+			std::copy_n(queue.begin(), popped, values.begin());
+			queue.erase(queue.begin(), queue.begin() + popped);
+			return static_cast<uint32_t>(popped);
+		}, batch, count);
+
+		printf("%-14s %8u %16.1f %16.1f\n", name, batch, ringRate, queueRate);
+	}
+
+	static void RingBuffers()
+	{
+		constexpr uint32_t count = 2000000;
+
+		printf("SPSC streaming, %u values (%u hardware threads)\n", count, std::thread::hardware_concurrency());
+		printf("%-14s %8s %16s %16s\n", "element", "batch", "ring (M/s)", "locked (M/s)");
+
+		for (uint32_t batch : { 1u, 64u })
+		{
+			StreamValues<uint8_t>("sound event", batch, count);
+			StreamValues<Frame*>("frame pointer", batch, count);
+		}
+
+		printf("\n");
+	}
+
+	/** Pace one second of interrupts against the host clock
+
+		Reports the wake up error percentiles and the cpu time the pacer used, for
+		a sleep only pacer and for one with the default spin tail.
+	*/
+	static void FramePacing()
+	{
+		constexpr uint64_t cyclesPerInterrupt = 16640;
+		constexpr int interrupts = 120;
+
+		printf("Frame pacing, %d interrupts (one second)\n", interrupts);
+		printf("%-14s %12s %12s %12s %10s\n", "spin tail (us)", "p50 (us)", "p99 (us)", "max (us)", "cpu (%)");
+
+		for (auto spinTail : { std::chrono::microseconds(0), std::chrono::microseconds(200) })
+		{
+			MH_FramePacer pacer(MH_FramePacer::i8080ArcadeClock, spinTail);
+			std::vector<double> errors;
+			auto cpuStart = std::clock();
+			pacer.Start(0);
+
+			for (uint64_t i = 1; i <= interrupts; i++)
+			{
+				errors.push_back(std::chrono::duration<double, std::micro>(pacer.Pace(i * cyclesPerInterrupt)).count());
+			}
+
+			auto cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+			std::sort(errors.begin(), errors.end());
+
+			printf("%-14lld %12.1f %12.1f %12.1f %10.1f\n", static_cast<long long>(spinTail.count()), errors[errors.size() / 2],
+				errors[errors.size() * 99 / 100], errors.back(), cpu * 100);
+		}
+
+		printf("\n");
+	}
+
+#ifdef ENABLE_MH_I8080ARCADE
+	/** The original upright 1bpp blit
+
+		Samples each destination bit individually from 8 vertically adjacent
+		source bytes, writing bottom up with a stride of -rowBytes.
+	*/
+	static void BlitUprightPerBit(std::vector<uint8_t>& dst, int rowBytes, const std::vector<uint8_t>& src)
+	{
+		static constexpr int srcWidth = 32;
+		static constexpr int srcRowSkip = srcWidth * 7;
+
+		auto begin = src.begin();
+		auto end = src.end();
+		auto start = dst.data() + rowBytes * (256 - 1);
+		auto ptr = start;
+
+		while (begin < end)
+		{
+			for (int i = 0; i < 8; i++)
+			{
+				uint8_t byte = 0;
+
+				for (int j = 0; j < 8; j++)
+				{
+					byte |= (((begin[j * srcWidth] >> i) & 0x01) << j);
+				}
+
+				*ptr = byte;
+				ptr - rowBytes >= dst.data() ? ptr -= rowBytes : ptr = ++start;
+			}
+
+			begin++;
+			begin += ((((begin - src.begin()) & (srcWidth - 1)) == 0) * srcRowSkip);
+		}
+	}
+
+	static void BlitUpright1bpp()
+	{
+		auto io = MakeI8080ArcadeIO();
+		auto src = std::vector<uint8_t>(7168);
+		FillVRAM(src);
+		io->SetOptions("{\"bpp\":1,\"orientation\":\"upright\"}");
+
+		printf("Upright 1bpp blit (ns per frame)\n");
+		printf("%-10s %12s %12s %8s\n", "rowBytes", "per-bit", "transpose", "speedup");
+
+		for (auto rowBytes : { 28, 32, 64 })
+		{
+			auto expected = std::vector<uint8_t>(rowBytes * 256);
+			auto actual = std::vector<uint8_t>(rowBytes * 256);
+
+			auto perBit = Measure([&] { BlitUprightPerBit(expected, rowBytes, src); });
+			auto transpose = Measure([&] { io->BlitVRAM(std::span(actual), rowBytes, std::span(src)); });
+
+			printf("%-10d %12.0f %12.0f %7.2fx%s\n", rowBytes, perBit, transpose, perBit / transpose, expected == actual ? "" : " (MISMATCH)");
+		}
+
+		printf("\n");
+	}
+
+	/** The original runtime dispatched blit
+
+		Switches on the blit mode every call, the 8bpp modes test the
+		orientation and the destination bounds for every pixel.
+	*/
+	static void BlitOriginal(std::vector<uint8_t>& dst, int rowBytes, const std::vector<uint8_t>& src, bool upright, bool rgb332, uint8_t colour)
+	{
+		auto decompressVram = [&](uint8_t* nextCol, bool cocktail)
+		{
+			auto vramStart = src.begin();
+			auto vramEnd = src.end();
+			int8_t shift = 0;
+			auto ptr = nextCol;
+
+			while (vramStart < vramEnd)
+			{
+				*ptr = ((*vramStart >> shift) & 0x01) * colour;
+				shift = (shift + 1) & 0x07;
+				vramStart += shift == 0;
+
+				if (cocktail == true)
+				{
+					if (++ptr - nextCol >= 256)
+					{
+						nextCol += rowBytes;
+						ptr = nextCol;
+					}
+				}
+				else
+				{
+					ptr - rowBytes < dst.data() ? ptr = ++nextCol : ptr -= rowBytes;
+				}
+			}
+		};
+
+		if (rgb332 == true)
+		{
+			decompressVram(upright == true ? dst.data() + rowBytes * (256 - 1) : dst.data(), upright == false);
+		}
+		else if (upright == true)
+		{
+			BlitUprightPerBit(dst, rowBytes, src);
+		}
+		else
+		{
+			for (size_t row = 0; row < src.size() / 32; row++)
+			{
+				std::copy_n(src.begin() + row * 32, 32, dst.begin() + row * rowBytes);
+			}
+		}
+	}
+
+	static void BlitModes()
+	{
+		auto io = MakeI8080ArcadeIO();
+		auto src = std::vector<uint8_t>(7168);
+		FillVRAM(src);
+
+		printf("Blit modes (ns per frame)\n");
+		printf("%-10s %-12s %12s %12s %8s\n", "bpp", "orientation", "original", "specialised", "speedup");
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			for (auto bpp : { 1, 8 })
+			{
+				char options[64];
+				snprintf(options, sizeof(options), "{\"bpp\":%d,\"colour\":\"white\",\"orientation\":\"%s\"}", bpp, orientation);
+				io->SetOptions(options);
+				auto rowBytes = io->GetVRAMWidth() * bpp / 8;
+				auto expected = std::vector<uint8_t>(rowBytes * io->GetVRAMHeight());
+				auto actual = expected;
+				auto upright = strcmp(orientation, "upright") == 0;
+
+				auto original = Measure([&] { BlitOriginal(expected, rowBytes, src, upright, bpp == 8, 0xFF); });
+				auto specialised = Measure([&] { io->BlitVRAM(std::span(actual), rowBytes, std::span(src)); });
+
+				printf("%-10d %-12s %12.0f %12.0f %7.2fx%s\n", bpp, orientation, original, specialised, original / specialised, expected == actual ? "" : " (MISMATCH)");
+			}
+		}
+
+		printf("\n");
+	}
+
+	static void BlitParallel()
+	{
+		auto io = MakeI8080ArcadeIO();
+		auto src = std::vector<uint8_t>(7168);
+		FillVRAM(src);
+		const int maxThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 4);
+
+		printf("Parallel 8bpp blit (ns per frame, %u hardware threads)\n", std::thread::hardware_concurrency());
+		printf("%-10s %-12s %12s %8s\n", "threads", "orientation", "time", "speedup");
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			char options[64];
+			snprintf(options, sizeof(options), "{\"bpp\":8,\"orientation\":\"%s\"}", orientation);
+			io->SetOptions(options);
+			auto dst = std::vector<uint8_t>(io->GetVRAMWidth() * io->GetVRAMHeight());
+			double single = 0;
+
+			for (int threads = 1; threads <= maxThreads; threads *= 2)
+			{
+				MH_WorkerPool pool(threads - 1);
+				MH_BlitExecutor executor = [&pool](int bandCount, const std::function<void(int)>& blitBand) { pool.Run(bandCount, blitBand); };
+				auto time = Measure([&] { io->BlitVRAMParallel(std::span(dst), io->GetVRAMWidth(), std::span(src), executor); });
+				single = threads == 1 ? time : single;
+
+				printf("%-10d %-12s %12.0f %7.2fx\n", threads, orientation, time, single / time);
+			}
+		}
+
+		printf("\n");
+	}
+
+	/** Cycle driven interrupts, polled after every instruction or run in batches
+
+		A stand in cpu executes one emulated second of 4 to 11 cycle instructions.
+		Polling calls GenerateInterrupt after every instruction, batching runs
+		straight to the cycle count returned by CyclesUntilInterrupt.
+	*/
+	static void InterruptScheduling()
+	{
+		auto io = MakeI8080ArcadeIO();
+		constexpr uint64_t second = 1996800;
+		int interrupts = 0;
+
+		auto step = [](uint32_t& seed)
+		{
+			seed = seed * 1664525 + 1013904223;
+			return 4 + (seed >> 29);
+		};
+
+		auto polled = Measure([&]
+		{
+			uint32_t seed = 1;
+			interrupts = 0;
+			// Restart the interrupt schedule at cycle 0
+			io->SetOptions("{\"timing\":\"cycles\"}");
+
+			for (uint64_t cycles = 0; cycles < second;)
+			{
+				cycles += step(seed);
+				interrupts += io->GenerateInterrupt(0, cycles) != 0;
+			}
+		}, 10);
+
+		auto polledInterrupts = interrupts;
+
+		auto batched = Measure([&]
+		{
+			uint32_t seed = 1;
+			interrupts = 0;
+			// Restart the interrupt schedule at cycle 0
+			io->SetOptions("{\"timing\":\"cycles\"}");
+
+			for (uint64_t cycles = 0; cycles < second;)
+			{
+				auto end = cycles + io->CyclesUntilInterrupt(cycles);
+
+				do
+				{
+					cycles += step(seed);
+				}
+				while (cycles < end);
+
+				interrupts += io->GenerateInterrupt(0, cycles) != 0;
+			}
+		}, 10);
+
+		printf("Cycle timed interrupts, one emulated second (us)\n");
+		printf("%-10s %12s %12s\n", "loop", "time", "interrupts");
+		printf("%-10s %12.0f %12d\n", "polled", polled / 1000, polledInterrupts);
+		printf("%-10s %12.0f %12d\n", "batched", batched / 1000, interrupts);
+		printf("\n");
+	}
+
+	/** Unthrottled emulation throughput
+
+		Runs the stand in cpu against cycle timing as fast as the host allows,
+		blitting an 8bpp upright frame at every vBlank that isn't skipped.
+	*/
+	static void FastForward()
+	{
+		auto io = MakeI8080ArcadeIO();
+		auto src = std::vector<uint8_t>(7168);
+		auto dst = std::vector<uint8_t>(224 * 256);
+		FillVRAM(src);
+		constexpr int frames = 600;
+
+		printf("Fast forward, %d frames on one core\n", frames);
+		printf("%-14s %16s\n", "frame-skip", "frames per sec");
+
+		for (auto skip : { "[0,1]", "[1,2]", "[3,4]", "[59,60]" })
+		{
+			char options[128];
+			snprintf(options, sizeof(options), "{\"bpp\":8,\"orientation\":\"upright\",\"timing\":\"cycles\",\"frame-skip\":%s}", skip);
+			io->SetOptions(options);
+
+			uint32_t seed = 1;
+			uint64_t cycles = 0;
+			auto start = std::chrono::steady_clock::now();
+
+			for (int frame = 0; frame < frames;)
+			{
+				auto end = cycles + io->CyclesUntilInterrupt(cycles);
+
+				do
+				{
+					seed = seed * 1664525 + 1013904223;
+					cycles += 4 + (seed >> 29);
+				}
+				while (cycles < end);
+
+				if (io->GenerateInterrupt(0, cycles) == 2)
+				{
+					io->BlitVRAM(std::span(dst), 224, std::span(src));
+					frame++;
+				}
+			}
+
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			printf("%-14s %16.0f\n", skip, frames / elapsed.count());
+		}
+
+		printf("\n");
+	}
+	static void AudioSynthesis()
+	{
+		auto io = MakeI8080ArcadeIO();
+		auto samples = std::vector<int16_t>(735);
+		constexpr int frames = 6000;
+
+		printf("Audio synthesis, %zu samples per 60hz frame at 44100hz\n", samples.size());
+		printf("%-14s %16s %14s\n", "voices", "samples per sec", "x realtime");
+
+		for (auto voices : { 1, 10 })
+		{
+			io->SetOptions("{\"audio-rate\":44100}");
+			io->WritePort(3, 0x00);
+			io->WritePort(5, 0x00);
+			auto start = std::chrono::steady_clock::now();
+
+			for (int frame = 0; frame < frames; frame++)
+			{
+				// Retrigger every half second so the one shot sounds keep sounding
+				if (frame % 30 == 0)
+				{
+					io->WritePort(3, 0x20);
+					io->WritePort(5, 0x00);
+					io->WritePort(3, voices == 1 ? 0x21 : 0x3F);
+					io->WritePort(5, voices == 1 ? 0x00 : 0x1F);
+				}
+
+				io->RenderAudio(std::span(samples));
+			}
+
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			auto rate = frames * samples.size() / elapsed.count();
+			printf("%-14d %16.0f %14.0f\n", voices, rate, rate / 44100);
+		}
+
+		printf("\n");
+	}
+#endif // ENABLE_MH_I8080ARCADE
+} // namespace meen_hw::benchmarks
+
+int main()
+{
+	printf("meen_hw %s benchmarks\n\n", meen_hw::Version());
+	meen_hw::benchmarks::LockContention();
+	meen_hw::benchmarks::ResourcePools();
+	meen_hw::benchmarks::FrameHandoff();
+	meen_hw::benchmarks::RingBuffers();
+	meen_hw::benchmarks::FramePacing();
+#ifdef ENABLE_MH_I8080ARCADE
+	meen_hw::benchmarks::BlitUpright1bpp();
+	meen_hw::benchmarks::BlitModes();
+	meen_hw::benchmarks::BlitParallel();
+	meen_hw::benchmarks::InterruptScheduling();
+	meen_hw::benchmarks::FastForward();
+	meen_hw::benchmarks::AudioSynthesis();
+#endif
+	return 0;
+}
@@ -20,12 +20,23 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
+#include <atomic>
 #include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #include <gtest/gtest.h>
+#include <thread>
 #include <vector>
 
 #include "meen_hw/MH_Factory.h"
+#include "meen_hw/MH_FramePacer.h"
 #include "meen_hw/MH_ResourcePool.h"
+#include "meen_hw/MH_RingBuffer.h"
+#include "meen_hw/MH_TripleBuffer.h"
+#include "meen_hw/i8080_arcade/MH_BlitKernels.h"
 
 namespace meen_hw::tests
 {
@@ -122,6 +133,816 @@ namespace meen_hw::tests
 		EXPECT_EQ(3, counter);
 	}
 
+	TEST_F(MeenHwTest, LockFreeResourcePool)
+	{
+		// The deleter is default constructed by the pool, each resource carries the counter to update
+		struct Resource
+		{
+			int value;
+			int* deletions;
+		};
+
+		struct ResourceDeleter
+		{
+			void operator()(Resource* resource)
+			{
+				(*resource->deletions)++;
+			};
+		};
+
+		int counter = 0;
+		Resource r1{ 0, &counter };
+		Resource r2{ 0, &counter };
+		Resource r3{ 0, &counter };
+
+		meen_hw::MH_LockFreeResourcePool<Resource, ResourceDeleter>::ResourcePtr outlivePool;
+
+		{
+			auto pool = meen_hw::MH_LockFreeResourcePool<Resource, ResourceDeleter>(2);
+
+			// An empty pool is a miss, not a failure to take a lock
+			EXPECT_EQ(nullptr, pool.GetResource());
+			EXPECT_EQ(1, pool.Stats().emptyMisses);
+
+			// The capacity is fixed, a resource past it is not taken
+			EXPECT_TRUE(pool.AddResource(&r1));
+			EXPECT_TRUE(pool.AddResource(&r2));
+			EXPECT_FALSE(pool.AddResource(&r3));
+
+			auto a = pool.GetResource();
+			auto b = pool.GetResource();
+			EXPECT_NE(nullptr, a);
+			EXPECT_NE(nullptr, b);
+			EXPECT_NE(a.get(), b.get());
+			EXPECT_EQ(nullptr, pool.GetResource());
+
+			// The most recently returned resource is handed out first
+			auto last = b.get();
+			b = nullptr;
+			b = pool.GetResource();
+			EXPECT_EQ(last, b.get());
+
+			auto stats = pool.Stats();
+			EXPECT_EQ(3, stats.acquires);
+			EXPECT_EQ(1, stats.releases);
+			EXPECT_EQ(0, stats.lockFailures);
+			EXPECT_EQ(2, stats.emptyMisses);
+			EXPECT_EQ(2, stats.outstanding);
+			EXPECT_EQ(2, stats.highWater);
+
+			b = nullptr;
+			outlivePool = std::move(a);
+			outlivePool->value = 42;
+		}
+
+		// The pool deleted the resource it held, the rejected resource was never its to delete
+		EXPECT_EQ(1, counter);
+		EXPECT_EQ(42, outlivePool->value);
+		outlivePool = nullptr;
+		EXPECT_EQ(2, counter);
+	}
+
+	TEST_F(MeenHwTest, LockFreeIndexStack)
+	{
+		// Simulates another thread running between a Pop reading the head and its exchange
+		struct Next
+		{
+			std::atomic<uint32_t> value{};
+			std::function<void()> interleave;
+
+			uint32_t load(std::memory_order order)
+			{
+				auto next = value.load(order);
+
+				if (auto other = std::move(interleave))
+				{
+					interleave = nullptr;
+					other();
+				}
+
+				return next;
+			}
+
+			void store(uint32_t next, std::memory_order order)
+			{
+				value.store(next, order);
+			}
+		};
+
+		struct Node
+		{
+			Next next;
+		};
+
+		Node nodes[3];
+		MH_LockFreeIndexStack stack;
+		uint32_t index = 0;
+
+		EXPECT_FALSE(stack.Pop(nodes, index));
+
+		stack.Push(nodes, 2);
+		stack.Push(nodes, 1);
+		stack.Push(nodes, 0);
+
+		// The head goes 0 -> 1 -> 2 while the pop has read next = 1, then back to
+		// index 0 with 1 still taken. Without the tag the pop would install 1 as the head.
+		nodes[0].next.interleave = [&]
+		{
+			uint32_t other;
+			stack.Pop(nodes, other);
+			stack.Pop(nodes, other);
+			stack.Push(nodes, 0);
+		};
+
+		EXPECT_TRUE(stack.Pop(nodes, index));
+		EXPECT_EQ(0, index);
+		EXPECT_TRUE(stack.Pop(nodes, index));
+		EXPECT_EQ(2, index);
+		EXPECT_FALSE(stack.Pop(nodes, index));
+	}
+
+	TEST_F(MeenHwTest, HandleResourcePool)
+	{
+		// The deleter is default constructed by the pool, each resource carries the counter to update
+		struct Resource
+		{
+			int value;
+			int* deletions;
+		};
+
+		struct ResourceDeleter
+		{
+			void operator()(Resource* resource)
+			{
+				(*resource->deletions)++;
+			};
+		};
+
+		using Pool = meen_hw::MH_HandleResourcePool<Resource, ResourceDeleter>;
+
+		int counter = 0;
+		Resource r1{ 0, &counter };
+		Resource r2{ 0, &counter };
+		Pool::ResourcePtr outlivePool;
+
+		// A handle is a block pointer plus index and generation
+		EXPECT_LT(sizeof(Pool::ResourcePtr), sizeof(meen_hw::MH_ResourcePool<Resource, ResourceDeleter>::ResourcePtr));
+
+		{
+			auto pool = Pool(2);
+			EXPECT_TRUE(pool.AddResource(&r1));
+			EXPECT_TRUE(pool.AddResource(&r2));
+
+			// A token resolves while its handle is live and not after a reset
+			auto handle = pool.GetResource();
+			ASSERT_NE(nullptr, handle.get());
+			auto token = handle.GetToken();
+			EXPECT_EQ(handle.get(), pool.Lookup(token));
+			handle.reset();
+			EXPECT_EQ(nullptr, pool.Lookup(token));
+
+			// Nor after the handle is released by assignment or by going out of scope
+			handle = pool.GetResource();
+			token = handle.GetToken();
+			handle = nullptr;
+			EXPECT_EQ(nullptr, pool.Lookup(token));
+
+			{
+				auto scoped = pool.GetResource();
+				token = scoped.GetToken();
+				EXPECT_EQ(scoped.get(), pool.Lookup(token));
+			}
+
+			EXPECT_EQ(nullptr, pool.Lookup(token));
+
+			// The slot is handed out again, the most recently returned first, with a new generation
+			auto reused = pool.GetResource();
+			EXPECT_EQ(token.index, reused.Index());
+			EXPECT_NE(token.generation, reused.Generation());
+			EXPECT_EQ(nullptr, pool.Lookup(token));
+			EXPECT_EQ(reused.get(), pool.Lookup(reused.GetToken()));
+
+			// Moving the handle keeps its token valid
+			token = reused.GetToken();
+			outlivePool = std::move(reused);
+			EXPECT_EQ(outlivePool.get(), pool.Lookup(token));
+			outlivePool->value = 42;
+		}
+
+		// The pool deleted its free resource, the outstanding one is deleted when it is released
+		EXPECT_EQ(1, counter);
+		EXPECT_EQ(42, outlivePool->value);
+		outlivePool = nullptr;
+		EXPECT_EQ(2, counter);
+	}
+
+	TEST_F(MeenHwTest, LockFreeResourcePoolStress)
+	{
+		// GTest only, the unity suite runs without std::thread so its lock-free pool coverage is single threaded
+		struct Resource
+		{
+			std::atomic<bool> inUse{};
+		};
+
+		constexpr int threadCount = 4;
+		constexpr int resourceCount = 8;
+		constexpr int iterations = 100000;
+		Resource resources[resourceCount];
+		std::atomic<int> drops{};
+		std::atomic<int> doubleAcquires{};
+
+		{
+			auto pool = MH_LockFreeResourcePool<Resource>(resourceCount);
+
+			for (auto& resource : resources)
+			{
+				EXPECT_TRUE(pool.AddResource(&resource));
+			}
+
+			std::vector<std::thread> threads;
+
+			for (int t = 0; t < threadCount; t++)
+			{
+				threads.emplace_back([&]
+				{
+					for (int i = 0; i < iterations; i++)
+					{
+						auto resource = pool.GetResource();
+
+						if (resource == nullptr)
+						{
+							drops++;
+							continue;
+						}
+
+						// No other thread may hold this resource
+						if (resource->inUse.exchange(true) == true)
+						{
+							doubleAcquires++;
+						}
+
+						resource->inUse.store(false);
+					}
+				});
+			}
+
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			// Every resource made it back to the pool
+			std::vector<MH_LockFreeResourcePool<Resource>::ResourcePtr> all;
+
+			for (int i = 0; i < resourceCount; i++)
+			{
+				all.push_back(pool.GetResource());
+				EXPECT_NE(nullptr, all.back());
+			}
+
+			EXPECT_EQ(nullptr, pool.GetResource());
+
+			// The resources live on the stack, don't let the pool delete them
+			for (auto& resource : all)
+			{
+				resource.release();
+			}
+		}
+
+		// There are always more resources than threads, so an acquire can never fail
+		EXPECT_EQ(0, drops);
+		EXPECT_EQ(0, doubleAcquires);
+	}
+
+	TEST_F(MeenHwTest, FixedResourcePool)
+	{
+		struct Frame
+		{
+			int id{ -1 };
+		};
+
+		MH_FixedResourcePool<Frame, 3>::ResourcePtr outlivePool;
+
+		{
+			auto pool = MH_FixedResourcePool<Frame, 3>(Frame{ 7 });
+			EXPECT_EQ(3, pool.Size());
+
+			{
+				auto r1 = pool.GetResource();
+				ASSERT_NE(nullptr, r1);
+				EXPECT_EQ(7, r1->id);
+				auto r2 = pool.GetResource();
+				ASSERT_NE(nullptr, r2);
+				auto r3 = pool.GetResource();
+				ASSERT_NE(nullptr, r3);
+
+				// Pool should now be empty
+				auto r4 = pool.GetResource();
+				EXPECT_EQ(nullptr, r4);
+
+				// The slots are contiguous and each one starts a new cache line
+				auto base = reinterpret_cast<uintptr_t>(r1.get());
+				EXPECT_EQ(0, base % 64);
+				EXPECT_EQ(64, reinterpret_cast<uintptr_t>(r2.get()) - base);
+				EXPECT_EQ(128, reinterpret_cast<uintptr_t>(r3.get()) - base);
+			}
+
+			// The most recently returned resource is handed out first
+			Frame* last = nullptr;
+
+			{
+				auto r1 = pool.GetResource();
+				last = r1.get();
+				r1->id = 42;
+			}
+
+			outlivePool = pool.GetResource();
+			ASSERT_NE(nullptr, outlivePool);
+			EXPECT_EQ(last, outlivePool.get());
+		}
+
+		// The pool is dead, the resource should still be valid
+		EXPECT_EQ(42, outlivePool->id);
+		outlivePool = nullptr;
+	}
+
+	TEST_F(MeenHwTest, ResourcePoolStats)
+	{
+		int resources[2]{};
+
+		// Every pool type counts the same sequence of events
+		auto checkStats = [](auto& pool)
+		{
+			{
+				auto r1 = pool.GetResource();
+				auto r2 = pool.GetResource();
+				auto r3 = pool.GetResource();
+				EXPECT_EQ(nullptr, r3);
+
+				auto stats = pool.Stats();
+				EXPECT_EQ(2, stats.acquires);
+				EXPECT_EQ(0, stats.releases);
+				EXPECT_EQ(1, stats.emptyMisses);
+				EXPECT_EQ(2, stats.outstanding);
+				EXPECT_EQ(2, stats.highWater);
+			}
+
+			auto r1 = pool.GetResource();
+			auto stats = pool.Stats();
+			EXPECT_EQ(3, stats.acquires);
+			EXPECT_EQ(2, stats.releases);
+			EXPECT_EQ(0, stats.lockFailures);
+			EXPECT_EQ(1, stats.emptyMisses);
+			EXPECT_EQ(1, stats.outstanding);
+			EXPECT_EQ(2, stats.highWater);
+		};
+
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete)> pool;
+		MH_LockFreeResourcePool<int, decltype(noDelete)> lockFreePool(2);
+
+		for (auto& resource : resources)
+		{
+			pool.AddResource(&resource);
+			lockFreePool.AddResource(&resource);
+		}
+
+		MH_FixedResourcePool<int, 2> fixedPool;
+
+		checkStats(pool);
+		checkStats(lockFreePool);
+		checkStats(fixedPool);
+	}
+
+	TEST_F(MeenHwTest, AcquireResource)
+	{
+		int resource = 0;
+		int releases = 0;
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete)> pool;
+		pool.AddResource(&resource);
+		pool.SetReleaseCallback([&releases] { releases++; });
+
+		{
+			// Available straight away
+			auto r1 = pool.AcquireResource(std::chrono::milliseconds(0));
+			ASSERT_NE(nullptr, r1);
+
+			// Empty, the wait times out
+			auto start = std::chrono::steady_clock::now();
+			auto r2 = pool.AcquireResource(std::chrono::milliseconds(20));
+			EXPECT_EQ(nullptr, r2);
+			EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+			EXPECT_EQ(0, releases);
+		}
+
+		EXPECT_EQ(1, releases);
+
+		// A waiter is woken when another thread returns a resource
+		auto held = pool.GetResource();
+		ASSERT_NE(nullptr, held);
+
+		std::thread releaser([&held]
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			held = nullptr;
+		});
+
+		auto woken = pool.AcquireResource(std::chrono::seconds(10));
+		releaser.join();
+		EXPECT_EQ(&resource, woken.get());
+		EXPECT_EQ(2, releases);
+
+		auto stats = pool.Stats();
+		EXPECT_EQ(3, stats.acquires);
+		EXPECT_EQ(0, stats.emptyMisses);
+		EXPECT_EQ(1, stats.timeouts);
+	}
+
+	TEST_F(MeenHwTest, ResourcePoolMagazine)
+	{
+		int resources[8]{};
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete)> pool(4);
+		int flushes = 0;
+
+		for (auto& resource : resources)
+		{
+			pool.AddResource(&resource);
+		}
+
+		pool.SetReleaseCallback([&flushes] { flushes++; });
+
+		// The first acquire moves half a magazine to this thread, the release stays local and isn't notified
+		{
+			auto resource = pool.GetResource();
+			ASSERT_NE(nullptr, resource);
+		}
+
+		EXPECT_EQ(0, flushes);
+
+		// Another thread only sees the shared pool, its magazine is flushed when it exits
+		size_t acquired = 0;
+
+		std::thread other([&pool, &acquired]
+		{
+			std::vector<decltype(pool.GetResource())> held;
+
+			while (auto resource = pool.GetResource())
+			{
+				held.emplace_back(std::move(resource));
+			}
+
+			acquired = held.size();
+		});
+
+		other.join();
+		EXPECT_EQ(6, acquired);
+		EXPECT_GT(flushes, 0);
+
+		// Everything is available to this thread again
+		std::vector<decltype(pool.GetResource())> held;
+
+		while (auto resource = pool.GetResource())
+		{
+			held.emplace_back(std::move(resource));
+		}
+
+		EXPECT_EQ(8, held.size());
+		held.clear();
+
+		auto stats = pool.Stats();
+		EXPECT_EQ(15, stats.acquires);
+		EXPECT_EQ(15, stats.releases);
+		EXPECT_EQ(0, stats.outstanding);
+		EXPECT_EQ(8, stats.highWater);
+	}
+
+	TEST_F(MeenHwTest, ResourcePoolMagazineWaiter)
+	{
+		int resources[4]{};
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete)> pool(4);
+
+		for (auto& resource : resources)
+		{
+			pool.AddResource(&resource);
+		}
+
+		std::atomic<bool> cached{};
+
+		std::thread other([&pool, &cached]
+		{
+			{
+				// Take every resource and return them, they all end up in this thread's magazine
+				std::vector<decltype(pool.GetResource())> held;
+
+				while (auto resource = pool.GetResource())
+				{
+					held.emplace_back(std::move(resource));
+				}
+
+				EXPECT_EQ(4, held.size());
+			}
+
+			cached = true;
+			cached.notify_one();
+
+			// Give the waiter time to block, then use the pool again
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			auto resource = pool.GetResource();
+			EXPECT_NE(nullptr, resource);
+		});
+
+		cached.wait(false);
+
+		// Every resource is free but cached by the other thread
+		EXPECT_EQ(nullptr, pool.GetResource());
+
+		// The waiter asks the magazines to flush, the other thread's next operation wakes it
+		auto resource = pool.AcquireResource(std::chrono::seconds(10));
+		EXPECT_NE(nullptr, resource);
+		other.join();
+
+		auto stats = pool.Stats();
+		EXPECT_EQ(0, stats.timeouts);
+	}
+
+	TEST_F(MeenHwTest, LockTypes)
+	{
+		auto checkLock = [](auto& lock)
+		{
+			EXPECT_TRUE(lock.try_lock());
+			EXPECT_FALSE(lock.try_lock());
+			lock.unlock();
+
+			{
+				MH_LockGuard lg(lock);
+				EXPECT_FALSE(lock.try_lock());
+			}
+
+			EXPECT_TRUE(lock.try_lock());
+			lock.unlock();
+		};
+
+		MH_SpinLock spinLock;
+		MH_HwSpinLock hwSpinLock;
+		MH_CriticalSection criticalSection;
+		MH_AdaptiveMutex adaptiveMutex;
+		MH_Mutex mutex;
+
+		checkLock(spinLock);
+		checkLock(hwSpinLock);
+		checkLock(criticalSection);
+		checkLock(adaptiveMutex);
+		checkLock(mutex);
+
+		// Mutual exclusion between threads, enough of them to make the adaptive mutex park
+		auto checkExclusion = [](auto& lock)
+		{
+			int counter = 0;
+			std::vector<std::thread> threads;
+
+			for (int t = 0; t < 8; t++)
+			{
+				threads.emplace_back([&lock, &counter]
+				{
+					for (int i = 0; i < 10000; i++)
+					{
+						MH_LockGuard lg(lock);
+						counter++;
+
+						if (i % 1000 == 0)
+						{
+							std::this_thread::sleep_for(std::chrono::microseconds(100));
+						}
+					}
+				});
+			}
+
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			EXPECT_EQ(80000, counter);
+		};
+
+		checkExclusion(spinLock);
+		checkExclusion(adaptiveMutex);
+
+		// The resource pool is parameterised on the lock type
+		int resource = 0;
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete), MH_SpinLock> pool;
+		pool.AddResource(&resource);
+
+		{
+			auto r1 = pool.GetResource();
+			EXPECT_EQ(&resource, r1.get());
+			EXPECT_EQ(nullptr, pool.GetResource());
+		}
+
+		EXPECT_EQ(&resource, pool.AcquireResource(std::chrono::milliseconds(0)).get());
+		EXPECT_EQ(2, pool.Stats().releases);
+	}
+
+	TEST_F(MeenHwTest, TripleBuffer)
+	{
+		MH_TripleBuffer<std::vector<uint8_t>> frames(7168);
+		EXPECT_EQ(7168, frames.Back().size());
+		EXPECT_EQ(7168, frames.Front().size());
+
+		// Nothing published yet
+		EXPECT_FALSE(frames.Acquire());
+
+		frames.Back()[0] = 1;
+		frames.Publish();
+		EXPECT_TRUE(frames.Acquire());
+		EXPECT_EQ(1, frames.Front()[0]);
+		EXPECT_FALSE(frames.Acquire());
+
+		// Only the newest of several publishes is seen, the rest are recycled
+		frames.Back()[0] = 2;
+		frames.Publish();
+		frames.Back()[0] = 3;
+		frames.Publish();
+		EXPECT_NE(&frames.Front(), &frames.Back());
+		EXPECT_TRUE(frames.Acquire());
+		EXPECT_EQ(3, frames.Front()[0]);
+		EXPECT_FALSE(frames.Acquire());
+		EXPECT_NE(&frames.Front(), &frames.Back());
+	}
+
+	TEST_F(MeenHwTest, TripleBufferThreaded)
+	{
+		constexpr int frameCount = 100000;
+		MH_TripleBuffer<std::vector<int>> frames(64);
+
+		std::thread producer([&frames]
+		{
+			for (int frame = 1; frame <= frameCount; frame++)
+			{
+				auto& back = frames.Back();
+				std::fill(back.begin(), back.end(), frame);
+				frames.Publish();
+			}
+		});
+
+		// Frames never go backwards and are never torn
+		int last = 0;
+		bool torn = false;
+
+		while (last < frameCount)
+		{
+			if (frames.Acquire() == true)
+			{
+				auto& front = frames.Front();
+				EXPECT_GT(front[0], last);
+				torn |= std::any_of(front.begin(), front.end(), [&front](int value) { return value != front[0]; });
+				last = front[0];
+			}
+		}
+
+		producer.join();
+		EXPECT_FALSE(torn);
+	}
+
+	TEST_F(MeenHwTest, RingBuffer)
+	{
+		MH_RingBuffer<uint8_t, 8> ring;
+		uint8_t out[16]{};
+
+		EXPECT_EQ(8, ring.Capacity());
+		EXPECT_FALSE(ring.Pop(out[0]));
+
+		// Single values
+		EXPECT_TRUE(ring.Push(1));
+		EXPECT_TRUE(ring.Push(2));
+		EXPECT_EQ(2, ring.Size());
+		EXPECT_TRUE(ring.Pop(out[0]));
+		EXPECT_EQ(1, out[0]);
+
+		// A batch only pushes what fits
+		const uint8_t in[10] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+		EXPECT_EQ(7, ring.Push(std::span(in)));
+		EXPECT_FALSE(ring.Push(13));
+		EXPECT_EQ(8, ring.Size());
+
+		// A batch pop wraps around the end of the ring
+		EXPECT_EQ(8, ring.Pop(std::span(out)));
+
+		for (int i = 0; i < 8; i++)
+		{
+			EXPECT_EQ(i + 2, out[i]);
+		}
+
+		EXPECT_EQ(0, ring.Size());
+		EXPECT_EQ(0, ring.Pop(std::span(out)));
+
+		// Large elements such as frame pointers
+		int frames[4]{};
+		MH_RingBuffer<int*, 4> pointers;
+
+		for (auto& frame : frames)
+		{
+			EXPECT_TRUE(pointers.Push(&frame));
+		}
+
+		int* frame = nullptr;
+		EXPECT_TRUE(pointers.Pop(frame));
+		EXPECT_EQ(&frames[0], frame);
+	}
+
+	TEST_F(MeenHwTest, RingBufferThreaded)
+	{
+		MH_RingBuffer<uint32_t, 64> ring;
+		constexpr uint32_t count = 200000;
+		bool ordered = true;
+
+		std::thread consumer([&ring, &ordered]
+		{
+			uint32_t values[16];
+			uint32_t expected = 0;
+
+			while (expected < count)
+			{
+				auto popped = ring.Pop(std::span(values));
+
+				for (uint32_t i = 0; i < popped; i++)
+				{
+					ordered &= values[i] == expected++;
+				}
+
+				if (popped == 0)
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		// Push in uneven batches so they straddle the end of the ring
+		uint32_t values[7];
+		uint32_t next = 0;
+
+		while (next < count)
+		{
+			auto batch = std::min<uint32_t>(7, count - next);
+
+			for (uint32_t i = 0; i < batch; i++)
+			{
+				values[i] = next + i;
+			}
+
+			auto pushed = ring.Push(std::span<const uint32_t>(values, batch));
+			next += pushed;
+
+			if (pushed == 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		consumer.join();
+		EXPECT_TRUE(ordered);
+		EXPECT_EQ(0, ring.Size());
+	}
+
+	TEST_F(MeenHwTest, FramePacer)
+	{
+		constexpr uint64_t cyclesPerInterrupt = 16640;
+		MH_FramePacer pacer;
+		pacer.Start(0);
+		auto start = MH_FramePacer::Now();
+
+		// Six interrupts are 50ms of emulated time
+		for (uint64_t i = 1; i <= 6; i++)
+		{
+			EXPECT_GE(pacer.Pace(i * cyclesPerInterrupt).count(), 0);
+		}
+
+		auto elapsed = MH_FramePacer::Now() - start;
+		EXPECT_GE(elapsed, std::chrono::milliseconds(50));
+
+		// A stall longer than maxLag restarts the schedule instead of racing to catch up
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		EXPECT_GT(pacer.Pace(7 * cyclesPerInterrupt), std::chrono::milliseconds(50));
+
+		start = MH_FramePacer::Now();
+		pacer.Pace(8 * cyclesPerInterrupt);
+		EXPECT_GE(MH_FramePacer::Now() - start, std::chrono::milliseconds(8));
+
+		auto stats = pacer.Stats();
+		EXPECT_EQ(8, stats.ticks);
+		EXPECT_EQ(1, stats.resyncs);
+		EXPECT_GE(stats.late, 1);
+
+		// A cycle count from before the schedule restarted is already due
+		start = MH_FramePacer::Now();
+		EXPECT_GE(pacer.Pace(cyclesPerInterrupt).count(), 0);
+		EXPECT_LT(MH_FramePacer::Now() - start, std::chrono::seconds(1));
+	}
+
 #ifdef ENABLE_MH_I8080ARCADE
 	TEST_F(MeenHwTest, ReadPort0)
 	{
@@ -241,6 +1062,199 @@ namespace meen_hw::tests
 		EXPECT_EQ(0, isr);
 	}
 
+	TEST_F(MeenHwTest, GenerateInterruptCycles)
+	{
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"timing\":\"cycles\"}"));
+		EXPECT_EQ(16640, i8080ArcadeIO_->CyclesUntilInterrupt(0));
+
+		// The time is ignored, only the cycle count matters
+		auto isr = i8080ArcadeIO_->GenerateInterrupt(8333333, 16639);
+		EXPECT_EQ(0, isr);
+		EXPECT_EQ(1, i8080ArcadeIO_->CyclesUntilInterrupt(16639));
+
+		isr = i8080ArcadeIO_->GenerateInterrupt(8333333, 16640);
+		EXPECT_EQ(1, isr);
+		EXPECT_EQ(16640, i8080ArcadeIO_->CyclesUntilInterrupt(16640));
+
+		isr = i8080ArcadeIO_->GenerateInterrupt(8333333, 33279);
+		EXPECT_EQ(0, isr);
+
+		isr = i8080ArcadeIO_->GenerateInterrupt(16666666, 33285);
+		EXPECT_EQ(2, isr);
+		EXPECT_EQ(16635, i8080ArcadeIO_->CyclesUntilInterrupt(33285));
+
+		// Only the most recent of several passed interrupts is returned
+		isr = i8080ArcadeIO_->GenerateInterrupt(16666666, 83200);
+		EXPECT_EQ(1, isr);
+		EXPECT_EQ(0, i8080ArcadeIO_->GenerateInterrupt(16666666, 83201));
+		EXPECT_EQ(16640, i8080ArcadeIO_->CyclesUntilInterrupt(83200));
+
+		// Time based timing has no cycle budget
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"timing\":\"time\"}"));
+		EXPECT_EQ(0, i8080ArcadeIO_->CyclesUntilInterrupt(0));
+	}
+
+	TEST_F(MeenHwTest, FrameSkip)
+	{
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\",\"timing\":\"cycles\",\"frame-skip\":[1,2]}"));
+
+		auto src = std::vector<uint8_t>(7168, 0xFF);
+		auto dst = std::vector<uint8_t>(7168);
+		auto blitted = [&dst] { return std::all_of(dst.begin(), dst.end(), [](uint8_t b) { return b == 0xFF; }); };
+
+		// The first frame is blitted
+		EXPECT_FALSE(i8080ArcadeIO_->FrameSkipped());
+		i8080ArcadeIO_->BlitVRAM(std::span(dst), 32, std::span(src));
+		EXPECT_TRUE(blitted());
+
+		// Interrupt 1 starts the second frame, it is skipped through to the next interrupt 1
+		std::fill(dst.begin(), dst.end(), 0);
+		EXPECT_EQ(1, i8080ArcadeIO_->GenerateInterrupt(0, 16640));
+		EXPECT_TRUE(i8080ArcadeIO_->FrameSkipped());
+		auto rect = i8080ArcadeIO_->BlitVRAMHalf(std::span(dst), 32, std::span(src), 1);
+		EXPECT_EQ(0, rect.width * rect.height);
+		EXPECT_EQ(2, i8080ArcadeIO_->GenerateInterrupt(0, 33280));
+		i8080ArcadeIO_->BlitVRAM(std::span(dst), 32, std::span(src));
+		EXPECT_EQ(0, i8080ArcadeIO_->BlitVRAMIncremental(std::span(dst), 32, std::span(src), {}));
+		EXPECT_TRUE(std::all_of(dst.begin(), dst.end(), [](uint8_t b) { return b == 0; }));
+
+		// The third frame is blitted
+		EXPECT_EQ(1, i8080ArcadeIO_->GenerateInterrupt(0, 49920));
+		EXPECT_FALSE(i8080ArcadeIO_->FrameSkipped());
+		i8080ArcadeIO_->BlitVRAM(std::span(dst), 32, std::span(src));
+		EXPECT_TRUE(blitted());
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"timing\":\"time\",\"frame-skip\":[0,1]}"));
+		EXPECT_FALSE(i8080ArcadeIO_->FrameSkipped());
+	}
+
+	TEST_F(MeenHwTest, BlitVRAMToBeam)
+	{
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":8,\"orientation\":\"cocktail\",\"timing\":\"cycles\"}"));
+
+		// Interrupt 2 fires as the beam enters vBlank, interrupt 1 near scanline 94
+		constexpr uint64_t frameStart = 33280 - 224 * 128;
+		EXPECT_EQ(224, i8080ArcadeIO_->GetScanline(0));
+		EXPECT_EQ(94, i8080ArcadeIO_->GetScanline(16640));
+		EXPECT_EQ(224, i8080ArcadeIO_->GetScanline(33280));
+		EXPECT_EQ(259, i8080ArcadeIO_->GetScanline(frameStart - 1));
+		EXPECT_EQ(0, i8080ArcadeIO_->GetScanline(frameStart));
+		EXPECT_EQ(100, i8080ArcadeIO_->GetScanline(frameStart + 100 * 128 + 127));
+
+		auto src = std::vector<uint8_t>(7168);
+
+		for (size_t i = 0; i < src.size(); i++)
+		{
+			src[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		auto expected = std::vector<uint8_t>(256 * 224);
+		auto actual = expected;
+		i8080ArcadeIO_->BlitVRAM(std::span(expected), 256, std::span(src));
+		auto rowsMatch = [&](int first, int last) { return std::equal(expected.begin() + first * 256, expected.begin() + last * 256, actual.begin() + first * 256); };
+
+		// In vBlank every row of the frame has been drawn
+		auto rect = i8080ArcadeIO_->BlitVRAMToBeam(std::span(actual), 256, std::span(src), 0);
+		EXPECT_EQ(224, rect.height);
+		EXPECT_TRUE(expected == actual);
+		std::fill(actual.begin(), actual.end(), 0);
+
+		// The next frame starts with nothing drawn
+		rect = i8080ArcadeIO_->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart);
+		EXPECT_EQ(0, rect.width * rect.height);
+
+		// Only the rows the beam has passed
+		rect = i8080ArcadeIO_->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart + 100 * 128 + 5);
+		EXPECT_EQ(0, rect.y);
+		EXPECT_EQ(100, rect.height);
+		EXPECT_TRUE(rowsMatch(0, 100));
+		EXPECT_EQ(0, actual[100 * 256]);
+
+		rect = i8080ArcadeIO_->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart + 100 * 128 + 127);
+		EXPECT_EQ(0, rect.width * rect.height);
+
+		rect = i8080ArcadeIO_->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart + 200 * 128);
+		EXPECT_EQ(100, rect.y);
+		EXPECT_EQ(100, rect.height);
+
+		// Into the next frame, the rest of the previous frame is drawn first
+		rect = i8080ArcadeIO_->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart + 33280 + 10 * 128);
+		EXPECT_EQ(0, rect.y);
+		EXPECT_EQ(224, rect.height);
+		EXPECT_TRUE(expected == actual);
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"timing\":\"time\"}"));
+	}
+
+	TEST_F(MeenHwTest, RenderAudio)
+	{
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"audio-rate\":22050}"));
+
+		auto samples = std::vector<int16_t>(4096);
+		// FNV-1a, the synthesiser is fixed point so its output is identical on every platform
+		auto hash = [&samples]
+		{
+			uint32_t h = 2166136261u;
+
+			for (auto sample : samples)
+			{
+				h = (h ^ static_cast<uint16_t>(sample)) * 16777619u;
+			}
+
+			return h;
+		};
+		auto play = [&](uint16_t port, uint8_t data)
+		{
+			// Restarting the sample rate stops any sounding voices
+			EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"audio-rate\":22050}"));
+			i8080ArcadeIO_->WritePort(port, data);
+			i8080ArcadeIO_->RenderAudio(std::span(samples));
+			i8080ArcadeIO_->WritePort(port, data & 0x20);
+			return hash();
+		};
+
+		// Silent while the amplifier is disabled
+		i8080ArcadeIO_->WritePort(3, 0x02);
+		i8080ArcadeIO_->RenderAudio(std::span(samples));
+		EXPECT_TRUE(std::all_of(samples.begin(), samples.end(), [](int16_t s) { return s == 0; }));
+
+		i8080ArcadeIO_->WritePort(3, 0x20);
+		auto shot = play(3, 0x22);
+		EXPECT_FALSE(std::all_of(samples.begin(), samples.end(), [](int16_t s) { return s == 0; }));
+		EXPECT_EQ(3804893493u, shot);
+		EXPECT_EQ(shot, play(3, 0x22));
+		EXPECT_NE(shot, play(3, 0x21));
+		EXPECT_NE(shot, play(5, 0x01));
+		EXPECT_NE(play(5, 0x01), play(5, 0x02));
+
+		// Overflow the event ring, the final port values still apply so the ufo stops and starts
+		auto silent = [&samples] { return std::all_of(samples.begin(), samples.end(), [](int16_t s) { return s == 0; }); };
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"audio-rate\":22050}"));
+
+		for (int i = 0; i < 300; i++)
+		{
+			i8080ArcadeIO_->WritePort(3, 0x21);
+		}
+
+		i8080ArcadeIO_->WritePort(3, 0x20);
+		i8080ArcadeIO_->RenderAudio(std::span(samples));
+		EXPECT_TRUE(silent());
+
+		for (int i = 0; i < 300; i++)
+		{
+			i8080ArcadeIO_->WritePort(3, 0x20);
+		}
+
+		i8080ArcadeIO_->WritePort(3, 0x21);
+		i8080ArcadeIO_->RenderAudio(std::span(samples));
+		EXPECT_FALSE(silent());
+
+		i8080ArcadeIO_->WritePort(3, 0x00);
+		i8080ArcadeIO_->WritePort(5, 0x00);
+		i8080ArcadeIO_->RenderAudio(std::span(samples));
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"audio-rate\":44100}"));
+	}
+
 	TEST_F(MeenHwTest, SetOptions)
 	{
 		auto checkErrc = [](const std::error_code& ec, bool success, const char* expectedMsg)
@@ -254,6 +1268,15 @@ namespace meen_hw::tests
 			checkErrc(i8080ArcadeIO_->SetOptions("{\"bpp\":2}"), false, "The bpp configuration option is invalid");
 			checkErrc(i8080ArcadeIO_->SetOptions("{\"colour\":\"black\" }"), false, "The colour configuration option is invalid");
 			checkErrc(i8080ArcadeIO_->SetOptions("{\"orientation\":\"up\"}"), false, "The orientation configuration parameter is invalid");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"scale\":5}"), false, "The scale configuration parameter is invalid");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"format\":\"rgb888\"}"), false, "The format configuration parameter is invalid");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"overlay\":[{\"x\":0,\"y\":0,\"width\":228,\"height\":8}]}"), false, "The overlay configuration parameter is invalid");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"colour\":\"FF80\"}"), false, "The colour configuration option is invalid");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"timing\":\"beam\"}"), false, "The timing configuration parameter is invalid");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"frame-skip\":[2,2]}"), false, "The frame-skip configuration parameter is invalid");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"audio-rate\":4000}"), false, "The audio-rate configuration parameter is invalid");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"bpp\":16,\"colour\":\"blue\",\"format\":\"bgr565\"}"), true, "Success");
+			checkErrc(i8080ArcadeIO_->SetOptions("{\"bpp\":32,\"colour\":\"FF8000\",\"format\":\"rgba8888\"}"), true, "Success");
 			checkErrc(i8080ArcadeIO_->SetOptions("syntax-error"), false, "A json parse error occurred while processing the configuration file");
 			checkErrc(i8080ArcadeIO_->SetOptions("{\"bpp\":8,\"colour\":\"random\",\"orientation\":\"cocktail\"}"), true, "Success");
 		);
@@ -268,6 +1291,76 @@ namespace meen_hw::tests
 		EXPECT_NO_THROW(i8080ArcadeIO_->SetOptions("{\"orientation\":\"upright\"}"););
 		EXPECT_EQ(224, i8080ArcadeIO_->GetVRAMWidth());
 		EXPECT_EQ(256, i8080ArcadeIO_->GetVRAMHeight());
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"scale\":3}"));
+		EXPECT_EQ(672, i8080ArcadeIO_->GetVRAMWidth());
+		EXPECT_EQ(768, i8080ArcadeIO_->GetVRAMHeight());
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"scale\":1}"));
+	}
+
+	TEST_F(MeenHwTest, ExpandKernels)
+	{
+		using namespace i8080_arcade;
+
+		// The scalar reference, bit 0 is the left most pixel
+		auto reference = [](const ExpandTable& table, int bpp, int scale, const std::vector<uint8_t>& src)
+		{
+			auto pixelBytes = bpp / 8;
+			std::vector<uint8_t> dst;
+
+			for (auto byte : src)
+			{
+				for (int bit = 0; bit < 8; bit++)
+				{
+					auto pixel = byte & (1 << bit) ? table.foreground : table.background;
+
+					for (int i = 0; i < scale * pixelBytes; i++)
+					{
+						dst.push_back(static_cast<uint8_t>(pixel >> (8 * (i % pixelBytes))));
+					}
+				}
+			}
+
+			return dst;
+		};
+
+		auto check = [&](ExpandKernel kernel, int bpp, int scale, uint32_t foreground, uint32_t background)
+		{
+			ExpandTable table;
+			BuildExpandTable(table, bpp, scale, foreground, background);
+
+			// Odd and short counts exercise the tails the vector loops leave to the table kernel
+			for (size_t count : { 1, 3, 5, 15, 16, 17, 31, 33, 100 })
+			{
+				std::vector<uint8_t> src(count);
+
+				for (size_t i = 0; i < count; i++)
+				{
+					src[i] = static_cast<uint8_t>(i * 37 + 11);
+				}
+
+				// One spare byte to catch an overrun
+				std::vector<uint8_t> dst(count * table.entryBytes + 1, 0xA5);
+				kernel(dst.data(), src.data(), count, table);
+				EXPECT_EQ(0xA5, dst.back());
+				dst.pop_back();
+				EXPECT_EQ(reference(table, bpp, scale, src), dst);
+			}
+		};
+
+		check(Expand1bppTable, 8, 1, 0xE0, 0x00);
+		check(Expand1bppTable, 8, 3, 0x1C, 0x03);
+		check(Expand1bppTable, 16, 2, 0xF800, 0x001F);
+		check(Expand1bppTable, 32, 1, 0xFF00FF00, 0x000000FF);
+		check(Expand1bppTable, 32, 4, 0x11223344, 0x55667788);
+		check(SelectExpandKernel(8, 1), 8, 1, 0xE0, 0x00);
+		check(SelectExpandKernel(16, 1), 16, 1, 0x07E0, 0x0000);
+		check(SelectExpandKernel(32, 1), 32, 1, 0xFF00FF00, 0x000000FF);
+#if defined(__x86_64__) || defined(_M_X64)
+		// The selected kernels are AVX2 when the host supports it, check the SSE2 fallbacks directly
+		check(Expand1bppTo8bppSse2, 8, 1, 0xE0, 0x00);
+		check(Expand1bppTo32bppSse2, 32, 1, 0xFF00FF00, 0x000000FF);
+#endif
 	}
 
 	TEST_F(MeenHwTest, BlitVRAM)
@@ -339,6 +1432,459 @@ namespace meen_hw::tests
 		// 8 bpp blit with upright orientation with padding
 		checkVRAM(std::span(srcVRAM), std::span(expectedVRAM), 224, 16, 0, "{\"bpp\":8,\"orientation\":\"upright\"}");
 	}
+
+	TEST_F(MeenHwTest, BlitVRAMRgb332Pattern)
+	{
+		uint8_t srcVRAM[7168];
+		auto dstVRAM = std::vector<uint8_t>(264 * 224);
+
+		// A pattern that exercises every bit position of every source byte
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":8,\"colour\":\"1C\",\"orientation\":\"cocktail\"}"));
+
+		// Blit with and without padding
+		for (auto rowBytes : { 256, 264 })
+		{
+			i8080ArcadeIO_->BlitVRAM(std::span(dstVRAM), rowBytes, std::span(srcVRAM));
+
+			for (int y = 0; y < 224; y++)
+			{
+				for (int x = 0; x < 256; x++)
+				{
+					auto expected = ((srcVRAM[y * 32 + (x >> 3)] >> (x & 0x07)) & 0x01) * 0x1C;
+					ASSERT_EQ(expected, dstVRAM[y * rowBytes + x]);
+				}
+			}
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"colour\":\"white\"}"));
+	}
+
+	TEST_F(MeenHwTest, BlitVRAMUprightPattern)
+	{
+		uint8_t srcVRAM[7168];
+		auto dstVRAM = std::vector<uint8_t>(30 * 256);
+
+		// A pattern that exercises every bit position of every source byte
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"orientation\":\"upright\"}"));
+
+		// Blit with and without padding
+		for (auto rowBytes : { 28, 30 })
+		{
+			i8080ArcadeIO_->BlitVRAM(std::span(dstVRAM), rowBytes, std::span(srcVRAM));
+
+			// The destination is the source rotated 90 degrees anti-clockwise
+			for (int y = 0; y < 256; y++)
+			{
+				for (int x = 0; x < 224; x++)
+				{
+					auto expected = (srcVRAM[x * 32 + ((255 - y) >> 3)] >> ((255 - y) & 0x07)) & 0x01;
+					ASSERT_EQ(expected, (dstVRAM[y * rowBytes + (x >> 3)] >> (x & 0x07)) & 0x01);
+				}
+			}
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":8,\"colour\":\"1C\"}"));
+		dstVRAM.resize(240 * 256);
+
+		for (auto rowBytes : { 224, 240 })
+		{
+			i8080ArcadeIO_->BlitVRAM(std::span(dstVRAM), rowBytes, std::span(srcVRAM));
+
+			for (int y = 0; y < 256; y++)
+			{
+				for (int x = 0; x < 224; x++)
+				{
+					auto expected = ((srcVRAM[x * 32 + ((255 - y) >> 3)] >> ((255 - y) & 0x07)) & 0x01) * 0x1C;
+					ASSERT_EQ(expected, dstVRAM[y * rowBytes + x]);
+				}
+			}
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"colour\":\"white\",\"orientation\":\"cocktail\"}"));
+	}
+
+	TEST_F(MeenHwTest, BlitVRAMIncremental)
+	{
+		struct Mode
+		{
+			const char* options;
+			int bytesPerPixel;
+			MH_Rect row10;
+			MH_Rect rows100To101;
+		};
+
+		Mode modes[] =
+		{
+			{ "{\"bpp\":1,\"orientation\":\"cocktail\"}", 0, { 0, 10, 256, 1 }, { 0, 100, 256, 2 } },
+			{ "{\"bpp\":8,\"orientation\":\"cocktail\"}", 1, { 0, 10, 256, 1 }, { 0, 100, 256, 2 } },
+			{ "{\"bpp\":1,\"orientation\":\"upright\"}", 0, { 8, 0, 8, 256 }, { 96, 0, 8, 256 } },
+			{ "{\"bpp\":8,\"orientation\":\"upright\"}", 1, { 8, 0, 8, 256 }, { 96, 0, 8, 256 } }
+		};
+
+		auto rectEq = [](const MH_Rect& expected, const MH_Rect& actual)
+		{
+			return expected.x == actual.x && expected.y == actual.y && expected.width == actual.width && expected.height == actual.height;
+		};
+
+		for (const auto& mode : modes)
+		{
+			auto srcVRAM = std::vector<uint8_t>(7168);
+			MH_Rect rects[4]{};
+
+			for (int i = 0; i < 7168; i++)
+			{
+				srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+			}
+
+			EXPECT_FALSE(i8080ArcadeIO_->SetOptions(mode.options));
+			// Pad each scanline so the row bytes differ from the natural pitch
+			auto rowBytes = (mode.bytesPerPixel ? i8080ArcadeIO_->GetVRAMWidth() : i8080ArcadeIO_->GetVRAMWidth() >> 3) + 8;
+			auto expected = std::vector<uint8_t>(rowBytes * i8080ArcadeIO_->GetVRAMHeight());
+			auto actual = expected;
+
+			// The first incremental blit is a full blit
+			EXPECT_EQ(1, i8080ArcadeIO_->BlitVRAMIncremental(std::span(actual), rowBytes, std::span(srcVRAM), std::span(rects)));
+			EXPECT_TRUE(rectEq(MH_Rect{ 0, 0, i8080ArcadeIO_->GetVRAMWidth(), i8080ArcadeIO_->GetVRAMHeight() }, rects[0]));
+			i8080ArcadeIO_->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+			EXPECT_TRUE(expected == actual);
+
+			// Nothing has changed
+			EXPECT_EQ(0, i8080ArcadeIO_->BlitVRAMIncremental(std::span(actual), rowBytes, std::span(srcVRAM), std::span(rects)));
+
+			// Change scanline 10 and scanlines 100 and 101
+			srcVRAM[10 * 32 + 3] ^= 0x10;
+			srcVRAM[100 * 32 + 31] ^= 0x80;
+			srcVRAM[101 * 32] ^= 0x01;
+
+			EXPECT_EQ(2, i8080ArcadeIO_->BlitVRAMIncremental(std::span(actual), rowBytes, std::span(srcVRAM), std::span(rects)));
+			EXPECT_TRUE(rectEq(mode.row10, rects[0]));
+			EXPECT_TRUE(rectEq(mode.rows100To101, rects[1]));
+			i8080ArcadeIO_->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+			EXPECT_TRUE(expected == actual);
+
+			// Not enough rects, the last rect covers both regions
+			srcVRAM[10 * 32 + 3] ^= 0x10;
+			srcVRAM[100 * 32 + 31] ^= 0x80;
+			srcVRAM[101 * 32] ^= 0x01;
+
+			EXPECT_EQ(1, i8080ArcadeIO_->BlitVRAMIncremental(std::span(actual), rowBytes, std::span(srcVRAM), std::span(rects, 1)));
+			EXPECT_EQ(mode.row10.x, rects[0].x);
+			EXPECT_EQ(mode.row10.y, rects[0].y);
+			EXPECT_EQ(mode.rows100To101.x + mode.rows100To101.width, rects[0].x + rects[0].width);
+			EXPECT_EQ(mode.rows100To101.y + mode.rows100To101.height, rects[0].y + rects[0].height);
+			i8080ArcadeIO_->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+			EXPECT_TRUE(expected == actual);
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\"}"));
+	}
+
+	TEST_F(MeenHwTest, BlitVRAMParallel)
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		// Run the bands in reverse order to check that they are independent of each other
+		int bandsBlitted = 0;
+		MH_BlitExecutor reverse = [&bandsBlitted](int bandCount, const std::function<void(int)>& blitBand)
+		{
+			for (int band = bandCount - 1; band >= 0; band--)
+			{
+				blitBand(band);
+				bandsBlitted++;
+			}
+		};
+
+		for (auto options : { "{\"bpp\":1,\"orientation\":\"cocktail\"}", "{\"bpp\":8,\"orientation\":\"cocktail\"}", "{\"bpp\":1,\"orientation\":\"upright\"}", "{\"bpp\":8,\"orientation\":\"upright\"}" })
+		{
+			EXPECT_FALSE(i8080ArcadeIO_->SetOptions(options));
+			auto rowBytes = i8080ArcadeIO_->GetVRAMWidth() + 8;
+			auto expected = std::vector<uint8_t>(rowBytes * i8080ArcadeIO_->GetVRAMHeight());
+			auto actual = expected;
+
+			i8080ArcadeIO_->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+
+			// Internal worker pool
+			i8080ArcadeIO_->BlitVRAMParallel(std::span(actual), rowBytes, std::span(srcVRAM), nullptr);
+			EXPECT_TRUE(expected == actual);
+
+			// Caller supplied executor
+			std::fill(actual.begin(), actual.end(), 0);
+			bandsBlitted = 0;
+			i8080ArcadeIO_->BlitVRAMParallel(std::span(actual), rowBytes, std::span(srcVRAM), reverse);
+			EXPECT_TRUE(expected == actual);
+			EXPECT_EQ(7, bandsBlitted);
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\"}"));
+	}
+
+	TEST_F(MeenHwTest, BlitVRAMScaled)
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		// Read a single pixel from a 1bpp or 8bpp buffer
+		auto pixel = [](const std::vector<uint8_t>& vram, int rowBytes, int bpp, int x, int y)
+		{
+			return bpp == 1 ? (vram[y * rowBytes + (x >> 3)] >> (x & 0x07)) & 0x01 : vram[y * rowBytes + x];
+		};
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			for (auto bpp : { 1, 8 })
+			{
+				char options[80];
+				snprintf(options, sizeof(options), "{\"bpp\":%d,\"colour\":\"1C\",\"orientation\":\"%s\",\"scale\":1}", bpp, orientation);
+				EXPECT_FALSE(i8080ArcadeIO_->SetOptions(options));
+
+				auto width = i8080ArcadeIO_->GetVRAMWidth();
+				auto height = i8080ArcadeIO_->GetVRAMHeight();
+				auto rowBytes = width * bpp / 8;
+				auto expected = std::vector<uint8_t>(rowBytes * height);
+				i8080ArcadeIO_->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+
+				for (auto scale : { 2, 3, 4 })
+				{
+					snprintf(options, sizeof(options), "{\"scale\":%d}", scale);
+					EXPECT_FALSE(i8080ArcadeIO_->SetOptions(options));
+
+					// Pad each scanline so the row bytes differ from the natural pitch
+					auto scaledRowBytes = i8080ArcadeIO_->GetVRAMWidth() * bpp / 8 + 4;
+					auto actual = std::vector<uint8_t>(scaledRowBytes * i8080ArcadeIO_->GetVRAMHeight());
+					i8080ArcadeIO_->BlitVRAM(std::span(actual), scaledRowBytes, std::span(srcVRAM));
+
+					// Each destination pixel is a copy of the unscaled pixel it covers
+					for (int y = 0; y < height * scale; y++)
+					{
+						for (int x = 0; x < width * scale; x++)
+						{
+							ASSERT_EQ(pixel(expected, rowBytes, bpp, x / scale, y / scale), pixel(actual, scaledRowBytes, bpp, x, y));
+						}
+					}
+				}
+			}
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"colour\":\"white\",\"orientation\":\"cocktail\",\"scale\":1}"));
+	}
+
+	TEST_F(MeenHwTest, BlitVRAMFormats)
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		// The packed values of the colour FF8000 and opaque black
+		struct
+		{
+			const char* format;
+			int bpp;
+			uint32_t foreground;
+			uint32_t background;
+		} formats[] =
+		{
+			{ "rgb565", 16, 0xFC00, 0x0000 },
+			{ "bgr565", 16, 0x041F, 0x0000 },
+			{ "argb8888", 32, 0xFFFF8000, 0xFF000000 },
+			{ "abgr8888", 32, 0xFF0080FF, 0xFF000000 },
+			{ "rgba8888", 32, 0xFF8000FF, 0x000000FF },
+			{ "bgra8888", 32, 0x0080FFFF, 0x000000FF }
+		};
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			for (auto scale : { 1, 2 })
+			{
+				char options[96];
+				snprintf(options, sizeof(options), "{\"bpp\":1,\"colour\":\"FF8000\",\"orientation\":\"%s\",\"scale\":%d}", orientation, scale);
+				EXPECT_FALSE(i8080ArcadeIO_->SetOptions(options));
+
+				auto width = i8080ArcadeIO_->GetVRAMWidth();
+				auto height = i8080ArcadeIO_->GetVRAMHeight();
+				auto mono = std::vector<uint8_t>(width / 8 * height);
+				i8080ArcadeIO_->BlitVRAM(std::span(mono), width / 8, std::span(srcVRAM));
+
+				for (const auto& f : formats)
+				{
+					snprintf(options, sizeof(options), "{\"bpp\":%d,\"format\":\"%s\"}", f.bpp, f.format);
+					EXPECT_FALSE(i8080ArcadeIO_->SetOptions(options));
+
+					// Pad each scanline so the row bytes differ from the natural pitch
+					auto rowBytes = width * f.bpp / 8 + 4;
+					auto actual = std::vector<uint8_t>(rowBytes * height);
+					i8080ArcadeIO_->BlitVRAM(std::span(actual), rowBytes, std::span(srcVRAM));
+
+					for (int y = 0; y < height; y++)
+					{
+						for (int x = 0; x < width; x++)
+						{
+							uint32_t pixel = 0;
+
+							if (f.bpp == 16)
+							{
+								uint16_t p16;
+								memcpy(&p16, actual.data() + y * rowBytes + x * 2, sizeof(p16));
+								pixel = p16;
+							}
+							else
+							{
+								memcpy(&pixel, actual.data() + y * rowBytes + x * 4, sizeof(pixel));
+							}
+
+							auto set = (mono[y * width / 8 + (x >> 3)] >> (x & 0x07)) & 0x01;
+							ASSERT_EQ(set ? f.foreground : f.background, pixel);
+						}
+					}
+				}
+			}
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"colour\":\"white\",\"orientation\":\"cocktail\",\"scale\":1}"));
+	}
+
+	TEST_F(MeenHwTest, BlitVRAMOverlay)
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		// The RGB332 colour of each upright pixel under the invaders overlay
+		auto gel = [](int ux, int uy) -> uint8_t
+		{
+			if (uy >= 240 && ux >= 16 && ux < 136) return 0x1C;
+			if (uy >= 184 && uy < 240) return 0x1C;
+			if (uy >= 32 && uy < 64) return 0xE0;
+			return 0xFF;
+		};
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			for (auto scale : { 1, 2 })
+			{
+				char options[96];
+				snprintf(options, sizeof(options), "{\"bpp\":1,\"orientation\":\"%s\",\"overlay\":\"none\",\"scale\":%d}", orientation, scale);
+				EXPECT_FALSE(i8080ArcadeIO_->SetOptions(options));
+
+				auto width = i8080ArcadeIO_->GetVRAMWidth();
+				auto height = i8080ArcadeIO_->GetVRAMHeight();
+				auto mono = std::vector<uint8_t>(width / 8 * height);
+				i8080ArcadeIO_->BlitVRAM(std::span(mono), width / 8, std::span(srcVRAM));
+
+				EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":8,\"colour\":\"white\",\"overlay\":\"invaders\"}"));
+				auto actual = std::vector<uint8_t>(width * height);
+				i8080ArcadeIO_->BlitVRAM(std::span(actual), width, std::span(srcVRAM));
+
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						// Map the destination pixel back to the upright screen
+						auto ux = x / scale;
+						auto uy = y / scale;
+
+						if (strcmp(orientation, "cocktail") == 0)
+						{
+							ux = y / scale;
+							uy = 255 - x / scale;
+						}
+
+						auto set = (mono[y * width / 8 + (x >> 3)] >> (x & 0x07)) & 0x01;
+						ASSERT_EQ(set ? gel(ux, uy) : 0, actual[y * width + x]);
+					}
+				}
+			}
+		}
+
+		// A user defined band replaces the preset
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"orientation\":\"upright\",\"overlay\":[{\"x\":8,\"y\":16,\"width\":8,\"height\":8,\"colour\":\"03\"}],\"scale\":1}"));
+		auto actual = std::vector<uint8_t>(224 * 256);
+		std::fill(srcVRAM.begin(), srcVRAM.end(), 0xFF);
+		i8080ArcadeIO_->BlitVRAM(std::span(actual), 224, std::span(srcVRAM));
+
+		for (int y = 0; y < 256; y++)
+		{
+			for (int x = 0; x < 224; x++)
+			{
+				ASSERT_EQ(x >= 8 && x < 16 && y >= 16 && y < 24 ? 0x03 : 0xFF, actual[y * 224 + x]);
+			}
+		}
+
+		EXPECT_TRUE(i8080ArcadeIO_->SetOptions("{\"overlay\":[{\"x\":4,\"y\":0,\"width\":8,\"height\":8}]}"));
+		EXPECT_TRUE(i8080ArcadeIO_->SetOptions("{\"overlay\":[{\"x\":0,\"y\":256,\"width\":8,\"height\":8}]}"));
+		EXPECT_TRUE(i8080ArcadeIO_->SetOptions("{\"overlay\":\"galaxians\"}"));
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\",\"overlay\":\"none\"}"));
+	}
+
+	TEST_F(MeenHwTest, BlitVRAMHalf)
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		for (auto options : { "{\"bpp\":1,\"orientation\":\"cocktail\"}", "{\"bpp\":8,\"orientation\":\"cocktail\"}", "{\"bpp\":1,\"orientation\":\"upright\"}", "{\"bpp\":8,\"orientation\":\"upright\"}" })
+		{
+			EXPECT_FALSE(i8080ArcadeIO_->SetOptions(options));
+			auto width = i8080ArcadeIO_->GetVRAMWidth();
+			auto height = i8080ArcadeIO_->GetVRAMHeight();
+			auto rowBytes = width + 8;
+			auto upright = height > width;
+			auto expected = std::vector<uint8_t>(rowBytes * height);
+			auto actual = expected;
+
+			i8080ArcadeIO_->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+
+			// No interrupt, nothing to blit
+			auto rect = i8080ArcadeIO_->BlitVRAMHalf(std::span(actual), rowBytes, std::span(srcVRAM), 0);
+			EXPECT_EQ(0, rect.width * rect.height);
+			EXPECT_TRUE(std::all_of(actual.begin(), actual.end(), [](uint8_t b) { return b == 0; }));
+
+			// Mid screen, the source scanlines the beam has drawn by scanline 94
+			rect = i8080ArcadeIO_->BlitVRAMHalf(std::span(actual), rowBytes, std::span(srcVRAM), 1);
+			EXPECT_EQ(0, rect.x);
+			EXPECT_EQ(0, rect.y);
+			EXPECT_EQ(upright ? 88 : 256, rect.width);
+			EXPECT_EQ(upright ? 256 : 88, rect.height);
+			EXPECT_FALSE(expected == actual);
+
+			// Vblank, the rest completes the frame
+			rect = i8080ArcadeIO_->BlitVRAMHalf(std::span(actual), rowBytes, std::span(srcVRAM), 2);
+			EXPECT_EQ(upright ? 88 : 0, rect.x);
+			EXPECT_EQ(upright ? 0 : 88, rect.y);
+			EXPECT_EQ(upright ? 136 : 256, rect.width);
+			EXPECT_EQ(upright ? 256 : 136, rect.height);
+			EXPECT_TRUE(expected == actual);
+		}
+
+		EXPECT_FALSE(i8080ArcadeIO_->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\"}"));
+	}
 #endif
 
 } // namespace meen_hw::tests
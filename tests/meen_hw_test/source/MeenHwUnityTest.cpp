@@ -20,7 +20,12 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <algorithm>
 #include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 #ifdef ENABLE_MH_RP2040
 #include <pico/stdlib.h>
 #endif
@@ -28,7 +33,11 @@ SOFTWARE.
 #include <vector>
 
 #include "meen_hw/MH_Factory.h"
+#include "meen_hw/MH_FramePacer.h"
 #include "meen_hw/MH_ResourcePool.h"
+#include "meen_hw/MH_RingBuffer.h"
+#include "meen_hw/MH_TripleBuffer.h"
+#include "meen_hw/i8080_arcade/MH_BlitKernels.h"
 
 void setUp(){}
 void tearDown(){}
@@ -127,6 +136,534 @@ namespace meen_hw::tests
 		TEST_ASSERT_EQUAL(3, resourceCounter);
 	}
 
+	static void test_LockFreeResourcePool()
+	{
+		// The deleter is default constructed by the pool, each resource carries the counter to update
+		struct Resource
+		{
+			int value;
+			int* deletions;
+		};
+
+		struct ResourceDeleter
+		{
+			void operator()(Resource* resource)
+			{
+				(*resource->deletions)++;
+			};
+		};
+
+		int counter = 0;
+		Resource r1{ 0, &counter };
+		Resource r2{ 0, &counter };
+		Resource r3{ 0, &counter };
+
+		meen_hw::MH_LockFreeResourcePool<Resource, ResourceDeleter>::ResourcePtr outlivePool;
+
+		{
+			auto pool = meen_hw::MH_LockFreeResourcePool<Resource, ResourceDeleter>(2);
+
+			// An empty pool is a miss, not a failure to take a lock
+			TEST_ASSERT_NULL(pool.GetResource());
+			TEST_ASSERT_EQUAL(1, pool.Stats().emptyMisses);
+
+			// The capacity is fixed, a resource past it is not taken
+			TEST_ASSERT_TRUE(pool.AddResource(&r1));
+			TEST_ASSERT_TRUE(pool.AddResource(&r2));
+			TEST_ASSERT_FALSE(pool.AddResource(&r3));
+
+			auto a = pool.GetResource();
+			auto b = pool.GetResource();
+			TEST_ASSERT_NOT_NULL(a);
+			TEST_ASSERT_NOT_NULL(b);
+			TEST_ASSERT_TRUE(a.get() != b.get());
+			TEST_ASSERT_NULL(pool.GetResource());
+
+			// The most recently returned resource is handed out first
+			auto last = b.get();
+			b = nullptr;
+			b = pool.GetResource();
+			TEST_ASSERT_EQUAL_PTR(last, b.get());
+
+			auto stats = pool.Stats();
+			TEST_ASSERT_EQUAL(3, stats.acquires);
+			TEST_ASSERT_EQUAL(1, stats.releases);
+			TEST_ASSERT_EQUAL(0, stats.lockFailures);
+			TEST_ASSERT_EQUAL(2, stats.emptyMisses);
+			TEST_ASSERT_EQUAL(2, stats.outstanding);
+			TEST_ASSERT_EQUAL(2, stats.highWater);
+
+			b = nullptr;
+			outlivePool = std::move(a);
+			outlivePool->value = 42;
+		}
+
+		// The pool deleted the resource it held, the rejected resource was never its to delete
+		TEST_ASSERT_EQUAL(1, counter);
+		TEST_ASSERT_EQUAL(42, outlivePool->value);
+		outlivePool = nullptr;
+		TEST_ASSERT_EQUAL(2, counter);
+	}
+
+	static void test_LockFreeIndexStack()
+	{
+		// Simulates another thread running between a Pop reading the head and its exchange
+		struct Next
+		{
+			std::atomic<uint32_t> value{};
+			std::function<void()> interleave;
+
+			uint32_t load(std::memory_order order)
+			{
+				auto next = value.load(order);
+
+				if (auto other = std::move(interleave))
+				{
+					interleave = nullptr;
+					other();
+				}
+
+				return next;
+			}
+
+			void store(uint32_t next, std::memory_order order)
+			{
+				value.store(next, order);
+			}
+		};
+
+		struct Node
+		{
+			Next next;
+		};
+
+		Node nodes[3];
+		MH_LockFreeIndexStack stack;
+		uint32_t index = 0;
+
+		TEST_ASSERT_FALSE(stack.Pop(nodes, index));
+
+		stack.Push(nodes, 2);
+		stack.Push(nodes, 1);
+		stack.Push(nodes, 0);
+
+		// The head goes 0 -> 1 -> 2 while the pop has read next = 1, then back to
+		// index 0 with 1 still taken. Without the tag the pop would install 1 as the head.
+		nodes[0].next.interleave = [&]
+		{
+			uint32_t other;
+			stack.Pop(nodes, other);
+			stack.Pop(nodes, other);
+			stack.Push(nodes, 0);
+		};
+
+		TEST_ASSERT_TRUE(stack.Pop(nodes, index));
+		TEST_ASSERT_EQUAL(0, index);
+		TEST_ASSERT_TRUE(stack.Pop(nodes, index));
+		TEST_ASSERT_EQUAL(2, index);
+		TEST_ASSERT_FALSE(stack.Pop(nodes, index));
+	}
+
+	static void test_HandleResourcePool()
+	{
+		// The deleter is default constructed by the pool, each resource carries the counter to update
+		struct Resource
+		{
+			int value;
+			int* deletions;
+		};
+
+		struct ResourceDeleter
+		{
+			void operator()(Resource* resource)
+			{
+				(*resource->deletions)++;
+			};
+		};
+
+		using Pool = meen_hw::MH_HandleResourcePool<Resource, ResourceDeleter>;
+
+		int counter = 0;
+		Resource r1{ 0, &counter };
+		Resource r2{ 0, &counter };
+		Pool::ResourcePtr outlivePool;
+
+		// A handle is a block pointer plus index and generation
+		TEST_ASSERT_TRUE(sizeof(Pool::ResourcePtr) < sizeof(meen_hw::MH_ResourcePool<Resource, ResourceDeleter>::ResourcePtr));
+
+		{
+			auto pool = Pool(2);
+			TEST_ASSERT_TRUE(pool.AddResource(&r1));
+			TEST_ASSERT_TRUE(pool.AddResource(&r2));
+
+			// A token resolves while its handle is live and not after a reset
+			auto handle = pool.GetResource();
+			TEST_ASSERT_NOT_NULL(handle.get());
+			auto token = handle.GetToken();
+			TEST_ASSERT_EQUAL_PTR(handle.get(), pool.Lookup(token));
+			handle.reset();
+			TEST_ASSERT_NULL(pool.Lookup(token));
+
+			// Nor after the handle is released by assignment or by going out of scope
+			handle = pool.GetResource();
+			token = handle.GetToken();
+			handle = nullptr;
+			TEST_ASSERT_NULL(pool.Lookup(token));
+
+			{
+				auto scoped = pool.GetResource();
+				token = scoped.GetToken();
+				TEST_ASSERT_EQUAL_PTR(scoped.get(), pool.Lookup(token));
+			}
+
+			TEST_ASSERT_NULL(pool.Lookup(token));
+
+			// The slot is handed out again, the most recently returned first, with a new generation
+			auto reused = pool.GetResource();
+			TEST_ASSERT_EQUAL(token.index, reused.Index());
+			TEST_ASSERT_NOT_EQUAL(token.generation, reused.Generation());
+			TEST_ASSERT_NULL(pool.Lookup(token));
+			TEST_ASSERT_EQUAL_PTR(reused.get(), pool.Lookup(reused.GetToken()));
+
+			// Moving the handle keeps its token valid
+			token = reused.GetToken();
+			outlivePool = std::move(reused);
+			TEST_ASSERT_EQUAL_PTR(outlivePool.get(), pool.Lookup(token));
+			outlivePool->value = 42;
+		}
+
+		// The pool deleted its free resource, the outstanding one is deleted when it is released
+		TEST_ASSERT_EQUAL(1, counter);
+		TEST_ASSERT_EQUAL(42, outlivePool->value);
+		outlivePool = nullptr;
+		TEST_ASSERT_EQUAL(2, counter);
+	}
+
+	static void test_FixedResourcePool()
+	{
+		struct Frame
+		{
+			int id{ -1 };
+		};
+
+		MH_FixedResourcePool<Frame, 3>::ResourcePtr outlivePool;
+
+		{
+			auto pool = MH_FixedResourcePool<Frame, 3>(Frame{ 7 });
+			TEST_ASSERT_EQUAL(3, pool.Size());
+
+			{
+				auto r1 = pool.GetResource();
+				TEST_ASSERT_NOT_NULL(r1);
+				TEST_ASSERT_EQUAL(7, r1->id);
+				auto r2 = pool.GetResource();
+				TEST_ASSERT_NOT_NULL(r2);
+				auto r3 = pool.GetResource();
+				TEST_ASSERT_NOT_NULL(r3);
+
+				// Pool should now be empty
+				auto r4 = pool.GetResource();
+				TEST_ASSERT_NULL(r4);
+
+				// The slots are contiguous and each one starts a new cache line
+				auto base = reinterpret_cast<uintptr_t>(r1.get());
+				TEST_ASSERT_EQUAL(0, base % 64);
+				TEST_ASSERT_EQUAL(64, reinterpret_cast<uintptr_t>(r2.get()) - base);
+				TEST_ASSERT_EQUAL(128, reinterpret_cast<uintptr_t>(r3.get()) - base);
+			}
+
+			// The most recently returned resource is handed out first
+			Frame* last = nullptr;
+
+			{
+				auto r1 = pool.GetResource();
+				last = r1.get();
+				r1->id = 42;
+			}
+
+			outlivePool = pool.GetResource();
+			TEST_ASSERT_NOT_NULL(outlivePool);
+			TEST_ASSERT_EQUAL_PTR(last, outlivePool.get());
+		}
+
+		// The pool is dead, the resource should still be valid
+		TEST_ASSERT_EQUAL(42, outlivePool->id);
+		outlivePool = nullptr;
+	}
+
+	static void test_ResourcePoolStats()
+	{
+		int resources[2]{};
+
+		// Every pool type counts the same sequence of events
+		auto checkStats = [](auto& pool)
+		{
+			{
+				auto r1 = pool.GetResource();
+				auto r2 = pool.GetResource();
+				auto r3 = pool.GetResource();
+				TEST_ASSERT_NULL(r3);
+
+				auto stats = pool.Stats();
+				TEST_ASSERT_EQUAL(2, stats.acquires);
+				TEST_ASSERT_EQUAL(0, stats.releases);
+				TEST_ASSERT_EQUAL(1, stats.emptyMisses);
+				TEST_ASSERT_EQUAL(2, stats.outstanding);
+				TEST_ASSERT_EQUAL(2, stats.highWater);
+			}
+
+			auto r1 = pool.GetResource();
+			auto stats = pool.Stats();
+			TEST_ASSERT_EQUAL(3, stats.acquires);
+			TEST_ASSERT_EQUAL(2, stats.releases);
+			TEST_ASSERT_EQUAL(0, stats.lockFailures);
+			TEST_ASSERT_EQUAL(1, stats.emptyMisses);
+			TEST_ASSERT_EQUAL(1, stats.outstanding);
+			TEST_ASSERT_EQUAL(2, stats.highWater);
+		};
+
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete)> pool;
+		MH_LockFreeResourcePool<int, decltype(noDelete)> lockFreePool(2);
+
+		for (auto& resource : resources)
+		{
+			pool.AddResource(&resource);
+			lockFreePool.AddResource(&resource);
+		}
+
+		MH_FixedResourcePool<int, 2> fixedPool;
+
+		checkStats(pool);
+		checkStats(lockFreePool);
+		checkStats(fixedPool);
+	}
+
+	static void test_AcquireResource()
+	{
+		int resource = 0;
+		int releases = 0;
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete)> pool;
+		pool.AddResource(&resource);
+		pool.SetReleaseCallback([&releases] { releases++; });
+
+		{
+			// Available straight away
+			auto r1 = pool.AcquireResource(std::chrono::milliseconds(0));
+			TEST_ASSERT_NOT_NULL(r1);
+
+			// Empty, the wait times out
+			auto r2 = pool.AcquireResource(std::chrono::milliseconds(20));
+			TEST_ASSERT_NULL(r2);
+			TEST_ASSERT_EQUAL(0, releases);
+		}
+
+		TEST_ASSERT_EQUAL(1, releases);
+
+		// The returned resource is available again
+		auto r1 = pool.AcquireResource(std::chrono::milliseconds(20));
+		TEST_ASSERT_EQUAL_PTR(&resource, r1.get());
+
+		auto stats = pool.Stats();
+		TEST_ASSERT_EQUAL(2, stats.acquires);
+		TEST_ASSERT_EQUAL(0, stats.emptyMisses);
+		TEST_ASSERT_EQUAL(1, stats.timeouts);
+	}
+
+	static void test_ResourcePoolMagazine()
+	{
+		int resources[8]{};
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete)> pool(4);
+
+		for (auto& resource : resources)
+		{
+			pool.AddResource(&resource);
+		}
+
+		// The first acquire moves half a magazine to this thread, the release stays local
+		{
+			auto resource = pool.GetResource();
+			TEST_ASSERT_NOT_NULL(resource);
+		}
+
+		// Releases beyond the magazine size are flushed back to the shared pool
+		std::vector<decltype(pool.GetResource())> held;
+
+		while (auto resource = pool.GetResource())
+		{
+			held.emplace_back(std::move(resource));
+		}
+
+		TEST_ASSERT_EQUAL(8, held.size());
+		held.clear();
+
+		while (auto resource = pool.GetResource())
+		{
+			held.emplace_back(std::move(resource));
+		}
+
+		TEST_ASSERT_EQUAL(8, held.size());
+		held.clear();
+
+		auto stats = pool.Stats();
+		TEST_ASSERT_EQUAL(17, stats.acquires);
+		TEST_ASSERT_EQUAL(17, stats.releases);
+		TEST_ASSERT_EQUAL(0, stats.outstanding);
+		TEST_ASSERT_EQUAL(8, stats.highWater);
+	}
+
+	static void test_LockTypes()
+	{
+		auto checkLock = [](auto& lock)
+		{
+			TEST_ASSERT_TRUE(lock.try_lock());
+			TEST_ASSERT_FALSE(lock.try_lock());
+			lock.unlock();
+
+			{
+				MH_LockGuard lg(lock);
+				TEST_ASSERT_FALSE(lock.try_lock());
+			}
+
+			TEST_ASSERT_TRUE(lock.try_lock());
+			lock.unlock();
+		};
+
+		MH_SpinLock spinLock;
+		MH_HwSpinLock hwSpinLock;
+		MH_CriticalSection criticalSection;
+
+		checkLock(spinLock);
+		checkLock(hwSpinLock);
+		checkLock(criticalSection);
+
+		// The resource pool is parameterised on the lock type
+		int resource = 0;
+		auto noDelete = [](int*) {};
+		MH_ResourcePool<int, decltype(noDelete), MH_CriticalSection> pool;
+		pool.AddResource(&resource);
+
+		{
+			auto r1 = pool.GetResource();
+			TEST_ASSERT_EQUAL_PTR(&resource, r1.get());
+			TEST_ASSERT_NULL(pool.GetResource());
+		}
+
+		TEST_ASSERT_EQUAL_PTR(&resource, pool.AcquireResource(std::chrono::milliseconds(0)).get());
+		TEST_ASSERT_EQUAL(2, pool.Stats().releases);
+	}
+
+	static void test_TripleBuffer()
+	{
+		MH_TripleBuffer<std::vector<uint8_t>> frames(7168);
+		TEST_ASSERT_EQUAL(7168, frames.Back().size());
+		TEST_ASSERT_EQUAL(7168, frames.Front().size());
+
+		// Nothing published yet
+		TEST_ASSERT_FALSE(frames.Acquire());
+
+		frames.Back()[0] = 1;
+		frames.Publish();
+		TEST_ASSERT_TRUE(frames.Acquire());
+		TEST_ASSERT_EQUAL(1, frames.Front()[0]);
+		TEST_ASSERT_FALSE(frames.Acquire());
+
+		// Only the newest of several publishes is seen, the rest are recycled
+		frames.Back()[0] = 2;
+		frames.Publish();
+		frames.Back()[0] = 3;
+		frames.Publish();
+		TEST_ASSERT_TRUE(&frames.Front() != &frames.Back());
+		TEST_ASSERT_TRUE(frames.Acquire());
+		TEST_ASSERT_EQUAL(3, frames.Front()[0]);
+		TEST_ASSERT_FALSE(frames.Acquire());
+		TEST_ASSERT_TRUE(&frames.Front() != &frames.Back());
+	}
+
+	static void test_RingBuffer()
+	{
+		MH_RingBuffer<uint8_t, 8> ring;
+		uint8_t out[16]{};
+
+		TEST_ASSERT_EQUAL(8, ring.Capacity());
+		TEST_ASSERT_FALSE(ring.Pop(out[0]));
+
+		// Single values
+		TEST_ASSERT_TRUE(ring.Push(1));
+		TEST_ASSERT_TRUE(ring.Push(2));
+		TEST_ASSERT_EQUAL(2, ring.Size());
+		TEST_ASSERT_TRUE(ring.Pop(out[0]));
+		TEST_ASSERT_EQUAL(1, out[0]);
+
+		// A batch only pushes what fits
+		const uint8_t in[10] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+		TEST_ASSERT_EQUAL(7, ring.Push(std::span(in)));
+		TEST_ASSERT_FALSE(ring.Push(13));
+		TEST_ASSERT_EQUAL(8, ring.Size());
+
+		// A batch pop wraps around the end of the ring
+		TEST_ASSERT_EQUAL(8, ring.Pop(std::span(out)));
+
+		for (int i = 0; i < 8; i++)
+		{
+			TEST_ASSERT_EQUAL(i + 2, out[i]);
+		}
+
+		TEST_ASSERT_EQUAL(0, ring.Size());
+		TEST_ASSERT_EQUAL(0, ring.Pop(std::span(out)));
+
+		// Large elements such as frame pointers
+		int frames[4]{};
+		MH_RingBuffer<int*, 4> pointers;
+
+		for (auto& frame : frames)
+		{
+			TEST_ASSERT_TRUE(pointers.Push(&frame));
+		}
+
+		int* frame = nullptr;
+		TEST_ASSERT_TRUE(pointers.Pop(frame));
+		TEST_ASSERT_EQUAL_PTR(&frames[0], frame);
+	}
+
+	static void test_FramePacer()
+	{
+		constexpr uint64_t cyclesPerInterrupt = 16640;
+		MH_FramePacer pacer;
+		pacer.Start(0);
+		auto start = MH_FramePacer::Now();
+
+		// Six interrupts are 50ms of emulated time
+		for (uint64_t i = 1; i <= 6; i++)
+		{
+			TEST_ASSERT_TRUE(pacer.Pace(i * cyclesPerInterrupt).count() >= 0);
+		}
+
+		auto elapsed = MH_FramePacer::Now() - start;
+		TEST_ASSERT_TRUE(elapsed >= std::chrono::milliseconds(50));
+
+		// A stall longer than maxLag restarts the schedule instead of racing to catch up
+		start = MH_FramePacer::Now();
+		while (MH_FramePacer::Now() - start < std::chrono::milliseconds(100));
+		TEST_ASSERT_TRUE(pacer.Pace(7 * cyclesPerInterrupt) > std::chrono::milliseconds(50));
+
+		start = MH_FramePacer::Now();
+		pacer.Pace(8 * cyclesPerInterrupt);
+		TEST_ASSERT_TRUE(MH_FramePacer::Now() - start >= std::chrono::milliseconds(8));
+
+		auto stats = pacer.Stats();
+		TEST_ASSERT_EQUAL(8, stats.ticks);
+		TEST_ASSERT_EQUAL(1, stats.resyncs);
+		TEST_ASSERT_TRUE(stats.late >= 1);
+
+		// A cycle count from before the schedule restarted is already due
+		start = MH_FramePacer::Now();
+		TEST_ASSERT_TRUE(pacer.Pace(cyclesPerInterrupt).count() >= 0);
+		TEST_ASSERT_TRUE(MH_FramePacer::Now() - start < std::chrono::seconds(1));
+	}
+
 #ifdef ENABLE_MH_I8080ARCADE
 	void test_ReadPort0()
 	{
@@ -246,6 +783,199 @@ namespace meen_hw::tests
 		TEST_ASSERT_EQUAL_UINT8(0, isr);
 	}
 
+	void test_GenerateInterruptCycles()
+	{
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"timing\":\"cycles\"}"));
+		TEST_ASSERT_EQUAL(16640, i8080ArcadeIO->CyclesUntilInterrupt(0));
+
+		// The time is ignored, only the cycle count matters
+		auto isr = i8080ArcadeIO->GenerateInterrupt(8333333, 16639);
+		TEST_ASSERT_EQUAL(0, isr);
+		TEST_ASSERT_EQUAL(1, i8080ArcadeIO->CyclesUntilInterrupt(16639));
+
+		isr = i8080ArcadeIO->GenerateInterrupt(8333333, 16640);
+		TEST_ASSERT_EQUAL(1, isr);
+		TEST_ASSERT_EQUAL(16640, i8080ArcadeIO->CyclesUntilInterrupt(16640));
+
+		isr = i8080ArcadeIO->GenerateInterrupt(8333333, 33279);
+		TEST_ASSERT_EQUAL(0, isr);
+
+		isr = i8080ArcadeIO->GenerateInterrupt(16666666, 33285);
+		TEST_ASSERT_EQUAL(2, isr);
+		TEST_ASSERT_EQUAL(16635, i8080ArcadeIO->CyclesUntilInterrupt(33285));
+
+		// Only the most recent of several passed interrupts is returned
+		isr = i8080ArcadeIO->GenerateInterrupt(16666666, 83200);
+		TEST_ASSERT_EQUAL(1, isr);
+		TEST_ASSERT_EQUAL(0, i8080ArcadeIO->GenerateInterrupt(16666666, 83201));
+		TEST_ASSERT_EQUAL(16640, i8080ArcadeIO->CyclesUntilInterrupt(83200));
+
+		// Time based timing has no cycle budget
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"timing\":\"time\"}"));
+		TEST_ASSERT_EQUAL(0, i8080ArcadeIO->CyclesUntilInterrupt(0));
+	}
+
+	void test_FrameSkip()
+	{
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\",\"timing\":\"cycles\",\"frame-skip\":[1,2]}"));
+
+		auto src = std::vector<uint8_t>(7168, 0xFF);
+		auto dst = std::vector<uint8_t>(7168);
+		auto blitted = [&dst] { return std::all_of(dst.begin(), dst.end(), [](uint8_t b) { return b == 0xFF; }); };
+
+		// The first frame is blitted
+		TEST_ASSERT_FALSE(i8080ArcadeIO->FrameSkipped());
+		i8080ArcadeIO->BlitVRAM(std::span(dst), 32, std::span(src));
+		TEST_ASSERT_TRUE(blitted());
+
+		// Interrupt 1 starts the second frame, it is skipped through to the next interrupt 1
+		std::fill(dst.begin(), dst.end(), 0);
+		TEST_ASSERT_EQUAL(1, i8080ArcadeIO->GenerateInterrupt(0, 16640));
+		TEST_ASSERT_TRUE(i8080ArcadeIO->FrameSkipped());
+		auto rect = i8080ArcadeIO->BlitVRAMHalf(std::span(dst), 32, std::span(src), 1);
+		TEST_ASSERT_EQUAL(0, rect.width * rect.height);
+		TEST_ASSERT_EQUAL(2, i8080ArcadeIO->GenerateInterrupt(0, 33280));
+		i8080ArcadeIO->BlitVRAM(std::span(dst), 32, std::span(src));
+		TEST_ASSERT_EQUAL(0, i8080ArcadeIO->BlitVRAMIncremental(std::span(dst), 32, std::span(src), {}));
+		TEST_ASSERT_TRUE(std::all_of(dst.begin(), dst.end(), [](uint8_t b) { return b == 0; }));
+
+		// The third frame is blitted
+		TEST_ASSERT_EQUAL(1, i8080ArcadeIO->GenerateInterrupt(0, 49920));
+		TEST_ASSERT_FALSE(i8080ArcadeIO->FrameSkipped());
+		i8080ArcadeIO->BlitVRAM(std::span(dst), 32, std::span(src));
+		TEST_ASSERT_TRUE(blitted());
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"timing\":\"time\",\"frame-skip\":[0,1]}"));
+		TEST_ASSERT_FALSE(i8080ArcadeIO->FrameSkipped());
+	}
+
+	void test_BlitVRAMToBeam()
+	{
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":8,\"orientation\":\"cocktail\",\"timing\":\"cycles\"}"));
+
+		// Interrupt 2 fires as the beam enters vBlank, interrupt 1 near scanline 94
+		constexpr uint64_t frameStart = 33280 - 224 * 128;
+		TEST_ASSERT_EQUAL(224, i8080ArcadeIO->GetScanline(0));
+		TEST_ASSERT_EQUAL(94, i8080ArcadeIO->GetScanline(16640));
+		TEST_ASSERT_EQUAL(224, i8080ArcadeIO->GetScanline(33280));
+		TEST_ASSERT_EQUAL(259, i8080ArcadeIO->GetScanline(frameStart - 1));
+		TEST_ASSERT_EQUAL(0, i8080ArcadeIO->GetScanline(frameStart));
+		TEST_ASSERT_EQUAL(100, i8080ArcadeIO->GetScanline(frameStart + 100 * 128 + 127));
+
+		auto src = std::vector<uint8_t>(7168);
+
+		for (size_t i = 0; i < src.size(); i++)
+		{
+			src[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		auto expected = std::vector<uint8_t>(256 * 224);
+		auto actual = expected;
+		i8080ArcadeIO->BlitVRAM(std::span(expected), 256, std::span(src));
+		auto rowsMatch = [&](int first, int last) { return std::equal(expected.begin() + first * 256, expected.begin() + last * 256, actual.begin() + first * 256); };
+
+		// In vBlank every row of the frame has been drawn
+		auto rect = i8080ArcadeIO->BlitVRAMToBeam(std::span(actual), 256, std::span(src), 0);
+		TEST_ASSERT_EQUAL(224, rect.height);
+		TEST_ASSERT_TRUE(expected == actual);
+		std::fill(actual.begin(), actual.end(), 0);
+
+		// The next frame starts with nothing drawn
+		rect = i8080ArcadeIO->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart);
+		TEST_ASSERT_EQUAL(0, rect.width * rect.height);
+
+		// Only the rows the beam has passed
+		rect = i8080ArcadeIO->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart + 100 * 128 + 5);
+		TEST_ASSERT_EQUAL(0, rect.y);
+		TEST_ASSERT_EQUAL(100, rect.height);
+		TEST_ASSERT_TRUE(rowsMatch(0, 100));
+		TEST_ASSERT_EQUAL(0, actual[100 * 256]);
+
+		rect = i8080ArcadeIO->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart + 100 * 128 + 127);
+		TEST_ASSERT_EQUAL(0, rect.width * rect.height);
+
+		rect = i8080ArcadeIO->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart + 200 * 128);
+		TEST_ASSERT_EQUAL(100, rect.y);
+		TEST_ASSERT_EQUAL(100, rect.height);
+
+		// Into the next frame, the rest of the previous frame is drawn first
+		rect = i8080ArcadeIO->BlitVRAMToBeam(std::span(actual), 256, std::span(src), frameStart + 33280 + 10 * 128);
+		TEST_ASSERT_EQUAL(0, rect.y);
+		TEST_ASSERT_EQUAL(224, rect.height);
+		TEST_ASSERT_TRUE(expected == actual);
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"timing\":\"time\"}"));
+	}
+
+	void test_RenderAudio()
+	{
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"audio-rate\":22050}"));
+
+		auto samples = std::vector<int16_t>(4096);
+		// FNV-1a, the synthesiser is fixed point so its output is identical on every platform
+		auto hash = [&samples]
+		{
+			uint32_t h = 2166136261u;
+
+			for (auto sample : samples)
+			{
+				h = (h ^ static_cast<uint16_t>(sample)) * 16777619u;
+			}
+
+			return h;
+		};
+		auto play = [&](uint16_t port, uint8_t data)
+		{
+			// Restarting the sample rate stops any sounding voices
+			TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"audio-rate\":22050}"));
+			i8080ArcadeIO->WritePort(port, data);
+			i8080ArcadeIO->RenderAudio(std::span(samples));
+			i8080ArcadeIO->WritePort(port, data & 0x20);
+			return hash();
+		};
+
+		// Silent while the amplifier is disabled
+		i8080ArcadeIO->WritePort(3, 0x02);
+		i8080ArcadeIO->RenderAudio(std::span(samples));
+		TEST_ASSERT_TRUE(std::all_of(samples.begin(), samples.end(), [](int16_t s) { return s == 0; }));
+
+		i8080ArcadeIO->WritePort(3, 0x20);
+		auto shot = play(3, 0x22);
+		TEST_ASSERT_FALSE(std::all_of(samples.begin(), samples.end(), [](int16_t s) { return s == 0; }));
+		TEST_ASSERT_EQUAL_UINT32(3804893493u, shot);
+		TEST_ASSERT_EQUAL_UINT32(shot, play(3, 0x22));
+		TEST_ASSERT_TRUE(shot != play(3, 0x21));
+		TEST_ASSERT_TRUE(shot != play(5, 0x01));
+		TEST_ASSERT_TRUE(play(5, 0x01) != play(5, 0x02));
+
+		// Overflow the event ring, the final port values still apply so the ufo stops and starts
+		auto silent = [&samples] { return std::all_of(samples.begin(), samples.end(), [](int16_t s) { return s == 0; }); };
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"audio-rate\":22050}"));
+
+		for (int i = 0; i < 300; i++)
+		{
+			i8080ArcadeIO->WritePort(3, 0x21);
+		}
+
+		i8080ArcadeIO->WritePort(3, 0x20);
+		i8080ArcadeIO->RenderAudio(std::span(samples));
+		TEST_ASSERT_TRUE(silent());
+
+		for (int i = 0; i < 300; i++)
+		{
+			i8080ArcadeIO->WritePort(3, 0x20);
+		}
+
+		i8080ArcadeIO->WritePort(3, 0x21);
+		i8080ArcadeIO->RenderAudio(std::span(samples));
+		TEST_ASSERT_FALSE(silent());
+
+		i8080ArcadeIO->WritePort(3, 0x00);
+		i8080ArcadeIO->WritePort(5, 0x00);
+		i8080ArcadeIO->RenderAudio(std::span(samples));
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"audio-rate\":44100}"));
+	}
+
 	void test_SetOptions()
 	{
 		auto checkErrc = [](const std::error_code& ec, bool success, const char* expectedMsg)
@@ -257,6 +987,15 @@ namespace meen_hw::tests
 		checkErrc(i8080ArcadeIO->SetOptions("{\"bpp\":2}"), false, "The bpp configuration option is invalid");
 		checkErrc(i8080ArcadeIO->SetOptions("{\"colour\":\"black\" }"), false, "The colour configuration option is invalid");
 		checkErrc(i8080ArcadeIO->SetOptions("{\"orientation\":\"up\"}"), false, "The orientation configuration parameter is invalid");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"scale\":5}"), false, "The scale configuration parameter is invalid");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"format\":\"rgb888\"}"), false, "The format configuration parameter is invalid");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"overlay\":[{\"x\":0,\"y\":0,\"width\":228,\"height\":8}]}"), false, "The overlay configuration parameter is invalid");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"colour\":\"FF80\"}"), false, "The colour configuration option is invalid");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"timing\":\"beam\"}"), false, "The timing configuration parameter is invalid");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"frame-skip\":[2,2]}"), false, "The frame-skip configuration parameter is invalid");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"audio-rate\":4000}"), false, "The audio-rate configuration parameter is invalid");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"bpp\":16,\"colour\":\"blue\",\"format\":\"bgr565\"}"), true, "Success");
+		checkErrc(i8080ArcadeIO->SetOptions("{\"bpp\":32,\"colour\":\"FF8000\",\"format\":\"rgba8888\"}"), true, "Success");
 		checkErrc(i8080ArcadeIO->SetOptions("syntax-error"), false, "A json parse error occurred while processing the configuration file");
 		checkErrc(i8080ArcadeIO->SetOptions("{\"bpp\":8,\"colour\":\"random\",\"orientation\":\"cocktail\"}"), true, "Success");
 	}
@@ -270,6 +1009,76 @@ namespace meen_hw::tests
 		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"orientation\":\"upright\"}"));
 		TEST_ASSERT_EQUAL_UINT16(224, i8080ArcadeIO->GetVRAMWidth());
 		TEST_ASSERT_EQUAL_UINT16(256, i8080ArcadeIO->GetVRAMHeight());
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"scale\":3}"));
+		TEST_ASSERT_EQUAL_UINT16(672, i8080ArcadeIO->GetVRAMWidth());
+		TEST_ASSERT_EQUAL_UINT16(768, i8080ArcadeIO->GetVRAMHeight());
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"scale\":1}"));
+	}
+
+	void test_ExpandKernels()
+	{
+		using namespace i8080_arcade;
+
+		// The scalar reference, bit 0 is the left most pixel
+		auto reference = [](const ExpandTable& table, int bpp, int scale, const std::vector<uint8_t>& src)
+		{
+			auto pixelBytes = bpp / 8;
+			std::vector<uint8_t> dst;
+
+			for (auto byte : src)
+			{
+				for (int bit = 0; bit < 8; bit++)
+				{
+					auto pixel = byte & (1 << bit) ? table.foreground : table.background;
+
+					for (int i = 0; i < scale * pixelBytes; i++)
+					{
+						dst.push_back(static_cast<uint8_t>(pixel >> (8 * (i % pixelBytes))));
+					}
+				}
+			}
+
+			return dst;
+		};
+
+		auto check = [&](ExpandKernel kernel, int bpp, int scale, uint32_t foreground, uint32_t background)
+		{
+			ExpandTable table;
+			BuildExpandTable(table, bpp, scale, foreground, background);
+
+			// Odd and short counts exercise the tails the vector loops leave to the table kernel
+			for (size_t count : { 1, 3, 5, 15, 16, 17, 31, 33, 100 })
+			{
+				std::vector<uint8_t> src(count);
+
+				for (size_t i = 0; i < count; i++)
+				{
+					src[i] = static_cast<uint8_t>(i * 37 + 11);
+				}
+
+				// One spare byte to catch an overrun
+				std::vector<uint8_t> dst(count * table.entryBytes + 1, 0xA5);
+				kernel(dst.data(), src.data(), count, table);
+				TEST_ASSERT_EQUAL_UINT8(0xA5, dst.back());
+				dst.pop_back();
+				TEST_ASSERT_TRUE(reference(table, bpp, scale, src) == dst);
+			}
+		};
+
+		check(Expand1bppTable, 8, 1, 0xE0, 0x00);
+		check(Expand1bppTable, 8, 3, 0x1C, 0x03);
+		check(Expand1bppTable, 16, 2, 0xF800, 0x001F);
+		check(Expand1bppTable, 32, 1, 0xFF00FF00, 0x000000FF);
+		check(Expand1bppTable, 32, 4, 0x11223344, 0x55667788);
+		check(SelectExpandKernel(8, 1), 8, 1, 0xE0, 0x00);
+		check(SelectExpandKernel(16, 1), 16, 1, 0x07E0, 0x0000);
+		check(SelectExpandKernel(32, 1), 32, 1, 0xFF00FF00, 0x000000FF);
+#if defined(__x86_64__) || defined(_M_X64)
+		// The selected kernels are AVX2 when the host supports it, check the SSE2 fallbacks directly
+		check(Expand1bppTo8bppSse2, 8, 1, 0xE0, 0x00);
+		check(Expand1bppTo32bppSse2, 32, 1, 0xFF00FF00, 0x000000FF);
+#endif
 	}
 
 	void test_BlitVRAM()
@@ -341,6 +1150,459 @@ namespace meen_hw::tests
 		// 8 bpp blit with upright orientation with padding
 		checkVRAM(std::span(srcVRAM), std::span(expectedVRAM), 224, 16, 0, "{\"bpp\":8,\"orientation\":\"upright\"}");
 	}
+
+	void test_BlitVRAMRgb332Pattern()
+	{
+		uint8_t srcVRAM[7168];
+		auto dstVRAM = std::vector<uint8_t>(264 * 224);
+
+		// A pattern that exercises every bit position of every source byte
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":8,\"colour\":\"1C\",\"orientation\":\"cocktail\"}"));
+
+		// Blit with and without padding
+		for (auto rowBytes : { 256, 264 })
+		{
+			i8080ArcadeIO->BlitVRAM(std::span(dstVRAM), rowBytes, std::span(srcVRAM));
+
+			for (int y = 0; y < 224; y++)
+			{
+				for (int x = 0; x < 256; x++)
+				{
+					auto expected = ((srcVRAM[y * 32 + (x >> 3)] >> (x & 0x07)) & 0x01) * 0x1C;
+					TEST_ASSERT_EQUAL_UINT8(expected, dstVRAM[y * rowBytes + x]);
+				}
+			}
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"colour\":\"white\"}"));
+	}
+
+	void test_BlitVRAMUprightPattern()
+	{
+		uint8_t srcVRAM[7168];
+		auto dstVRAM = std::vector<uint8_t>(30 * 256);
+
+		// A pattern that exercises every bit position of every source byte
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"orientation\":\"upright\"}"));
+
+		// Blit with and without padding
+		for (auto rowBytes : { 28, 30 })
+		{
+			i8080ArcadeIO->BlitVRAM(std::span(dstVRAM), rowBytes, std::span(srcVRAM));
+
+			// The destination is the source rotated 90 degrees anti-clockwise
+			for (int y = 0; y < 256; y++)
+			{
+				for (int x = 0; x < 224; x++)
+				{
+					auto expected = (srcVRAM[x * 32 + ((255 - y) >> 3)] >> ((255 - y) & 0x07)) & 0x01;
+					TEST_ASSERT_EQUAL_UINT8(expected, (dstVRAM[y * rowBytes + (x >> 3)] >> (x & 0x07)) & 0x01);
+				}
+			}
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":8,\"colour\":\"1C\"}"));
+		dstVRAM.resize(240 * 256);
+
+		for (auto rowBytes : { 224, 240 })
+		{
+			i8080ArcadeIO->BlitVRAM(std::span(dstVRAM), rowBytes, std::span(srcVRAM));
+
+			for (int y = 0; y < 256; y++)
+			{
+				for (int x = 0; x < 224; x++)
+				{
+					auto expected = ((srcVRAM[x * 32 + ((255 - y) >> 3)] >> ((255 - y) & 0x07)) & 0x01) * 0x1C;
+					TEST_ASSERT_EQUAL_UINT8(expected, dstVRAM[y * rowBytes + x]);
+				}
+			}
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"colour\":\"white\",\"orientation\":\"cocktail\"}"));
+	}
+
+	void test_BlitVRAMIncremental()
+	{
+		struct Mode
+		{
+			const char* options;
+			int bytesPerPixel;
+			MH_Rect row10;
+			MH_Rect rows100To101;
+		};
+
+		Mode modes[] =
+		{
+			{ "{\"bpp\":1,\"orientation\":\"cocktail\"}", 0, { 0, 10, 256, 1 }, { 0, 100, 256, 2 } },
+			{ "{\"bpp\":8,\"orientation\":\"cocktail\"}", 1, { 0, 10, 256, 1 }, { 0, 100, 256, 2 } },
+			{ "{\"bpp\":1,\"orientation\":\"upright\"}", 0, { 8, 0, 8, 256 }, { 96, 0, 8, 256 } },
+			{ "{\"bpp\":8,\"orientation\":\"upright\"}", 1, { 8, 0, 8, 256 }, { 96, 0, 8, 256 } }
+		};
+
+		auto rectEq = [](const MH_Rect& expected, const MH_Rect& actual)
+		{
+			return expected.x == actual.x && expected.y == actual.y && expected.width == actual.width && expected.height == actual.height;
+		};
+
+		for (const auto& mode : modes)
+		{
+			auto srcVRAM = std::vector<uint8_t>(7168);
+			MH_Rect rects[4]{};
+
+			for (int i = 0; i < 7168; i++)
+			{
+				srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+			}
+
+			TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions(mode.options));
+			// Pad each scanline so the row bytes differ from the natural pitch
+			auto rowBytes = (mode.bytesPerPixel ? i8080ArcadeIO->GetVRAMWidth() : i8080ArcadeIO->GetVRAMWidth() >> 3) + 8;
+			auto expected = std::vector<uint8_t>(rowBytes * i8080ArcadeIO->GetVRAMHeight());
+			auto actual = expected;
+
+			// The first incremental blit is a full blit
+			TEST_ASSERT_EQUAL(1, i8080ArcadeIO->BlitVRAMIncremental(std::span(actual), rowBytes, std::span(srcVRAM), std::span(rects)));
+			TEST_ASSERT_TRUE(rectEq(MH_Rect{ 0, 0, i8080ArcadeIO->GetVRAMWidth(), i8080ArcadeIO->GetVRAMHeight() }, rects[0]));
+			i8080ArcadeIO->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+			TEST_ASSERT_TRUE(expected == actual);
+
+			// Nothing has changed
+			TEST_ASSERT_EQUAL(0, i8080ArcadeIO->BlitVRAMIncremental(std::span(actual), rowBytes, std::span(srcVRAM), std::span(rects)));
+
+			// Change scanline 10 and scanlines 100 and 101
+			srcVRAM[10 * 32 + 3] ^= 0x10;
+			srcVRAM[100 * 32 + 31] ^= 0x80;
+			srcVRAM[101 * 32] ^= 0x01;
+
+			TEST_ASSERT_EQUAL(2, i8080ArcadeIO->BlitVRAMIncremental(std::span(actual), rowBytes, std::span(srcVRAM), std::span(rects)));
+			TEST_ASSERT_TRUE(rectEq(mode.row10, rects[0]));
+			TEST_ASSERT_TRUE(rectEq(mode.rows100To101, rects[1]));
+			i8080ArcadeIO->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+			TEST_ASSERT_TRUE(expected == actual);
+
+			// Not enough rects, the last rect covers both regions
+			srcVRAM[10 * 32 + 3] ^= 0x10;
+			srcVRAM[100 * 32 + 31] ^= 0x80;
+			srcVRAM[101 * 32] ^= 0x01;
+
+			TEST_ASSERT_EQUAL(1, i8080ArcadeIO->BlitVRAMIncremental(std::span(actual), rowBytes, std::span(srcVRAM), std::span(rects, 1)));
+			TEST_ASSERT_EQUAL(mode.row10.x, rects[0].x);
+			TEST_ASSERT_EQUAL(mode.row10.y, rects[0].y);
+			TEST_ASSERT_EQUAL(mode.rows100To101.x + mode.rows100To101.width, rects[0].x + rects[0].width);
+			TEST_ASSERT_EQUAL(mode.rows100To101.y + mode.rows100To101.height, rects[0].y + rects[0].height);
+			i8080ArcadeIO->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+			TEST_ASSERT_TRUE(expected == actual);
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\"}"));
+	}
+
+	void test_BlitVRAMParallel()
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		// Run the bands in reverse order to check that they are independent of each other
+		int bandsBlitted = 0;
+		MH_BlitExecutor reverse = [&bandsBlitted](int bandCount, const std::function<void(int)>& blitBand)
+		{
+			for (int band = bandCount - 1; band >= 0; band--)
+			{
+				blitBand(band);
+				bandsBlitted++;
+			}
+		};
+
+		for (auto options : { "{\"bpp\":1,\"orientation\":\"cocktail\"}", "{\"bpp\":8,\"orientation\":\"cocktail\"}", "{\"bpp\":1,\"orientation\":\"upright\"}", "{\"bpp\":8,\"orientation\":\"upright\"}" })
+		{
+			TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions(options));
+			auto rowBytes = i8080ArcadeIO->GetVRAMWidth() + 8;
+			auto expected = std::vector<uint8_t>(rowBytes * i8080ArcadeIO->GetVRAMHeight());
+			auto actual = expected;
+
+			i8080ArcadeIO->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+
+			// Internal worker pool
+			i8080ArcadeIO->BlitVRAMParallel(std::span(actual), rowBytes, std::span(srcVRAM), nullptr);
+			TEST_ASSERT_TRUE(expected == actual);
+
+			// Caller supplied executor
+			std::fill(actual.begin(), actual.end(), 0);
+			bandsBlitted = 0;
+			i8080ArcadeIO->BlitVRAMParallel(std::span(actual), rowBytes, std::span(srcVRAM), reverse);
+			TEST_ASSERT_TRUE(expected == actual);
+			TEST_ASSERT_EQUAL(7, bandsBlitted);
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\"}"));
+	}
+
+	void test_BlitVRAMScaled()
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		// Read a single pixel from a 1bpp or 8bpp buffer
+		auto pixel = [](const std::vector<uint8_t>& vram, int rowBytes, int bpp, int x, int y)
+		{
+			return bpp == 1 ? (vram[y * rowBytes + (x >> 3)] >> (x & 0x07)) & 0x01 : vram[y * rowBytes + x];
+		};
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			for (auto bpp : { 1, 8 })
+			{
+				char options[80];
+				snprintf(options, sizeof(options), "{\"bpp\":%d,\"colour\":\"1C\",\"orientation\":\"%s\",\"scale\":1}", bpp, orientation);
+				TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions(options));
+
+				auto width = i8080ArcadeIO->GetVRAMWidth();
+				auto height = i8080ArcadeIO->GetVRAMHeight();
+				auto rowBytes = width * bpp / 8;
+				auto expected = std::vector<uint8_t>(rowBytes * height);
+				i8080ArcadeIO->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+
+				for (auto scale : { 2, 3, 4 })
+				{
+					snprintf(options, sizeof(options), "{\"scale\":%d}", scale);
+					TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions(options));
+
+					// Pad each scanline so the row bytes differ from the natural pitch
+					auto scaledRowBytes = i8080ArcadeIO->GetVRAMWidth() * bpp / 8 + 4;
+					auto actual = std::vector<uint8_t>(scaledRowBytes * i8080ArcadeIO->GetVRAMHeight());
+					i8080ArcadeIO->BlitVRAM(std::span(actual), scaledRowBytes, std::span(srcVRAM));
+
+					// Each destination pixel is a copy of the unscaled pixel it covers
+					for (int y = 0; y < height * scale; y++)
+					{
+						for (int x = 0; x < width * scale; x++)
+						{
+							TEST_ASSERT_EQUAL_UINT8(pixel(expected, rowBytes, bpp, x / scale, y / scale), pixel(actual, scaledRowBytes, bpp, x, y));
+						}
+					}
+				}
+			}
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"colour\":\"white\",\"orientation\":\"cocktail\",\"scale\":1}"));
+	}
+
+	void test_BlitVRAMFormats()
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		// The packed values of the colour FF8000 and opaque black
+		struct
+		{
+			const char* format;
+			int bpp;
+			uint32_t foreground;
+			uint32_t background;
+		} formats[] =
+		{
+			{ "rgb565", 16, 0xFC00, 0x0000 },
+			{ "bgr565", 16, 0x041F, 0x0000 },
+			{ "argb8888", 32, 0xFFFF8000, 0xFF000000 },
+			{ "abgr8888", 32, 0xFF0080FF, 0xFF000000 },
+			{ "rgba8888", 32, 0xFF8000FF, 0x000000FF },
+			{ "bgra8888", 32, 0x0080FFFF, 0x000000FF }
+		};
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			for (auto scale : { 1, 2 })
+			{
+				char options[96];
+				snprintf(options, sizeof(options), "{\"bpp\":1,\"colour\":\"FF8000\",\"orientation\":\"%s\",\"scale\":%d}", orientation, scale);
+				TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions(options));
+
+				auto width = i8080ArcadeIO->GetVRAMWidth();
+				auto height = i8080ArcadeIO->GetVRAMHeight();
+				auto mono = std::vector<uint8_t>(width / 8 * height);
+				i8080ArcadeIO->BlitVRAM(std::span(mono), width / 8, std::span(srcVRAM));
+
+				for (const auto& f : formats)
+				{
+					snprintf(options, sizeof(options), "{\"bpp\":%d,\"format\":\"%s\"}", f.bpp, f.format);
+					TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions(options));
+
+					// Pad each scanline so the row bytes differ from the natural pitch
+					auto rowBytes = width * f.bpp / 8 + 4;
+					auto actual = std::vector<uint8_t>(rowBytes * height);
+					i8080ArcadeIO->BlitVRAM(std::span(actual), rowBytes, std::span(srcVRAM));
+
+					for (int y = 0; y < height; y++)
+					{
+						for (int x = 0; x < width; x++)
+						{
+							uint32_t pixel = 0;
+
+							if (f.bpp == 16)
+							{
+								uint16_t p16;
+								memcpy(&p16, actual.data() + y * rowBytes + x * 2, sizeof(p16));
+								pixel = p16;
+							}
+							else
+							{
+								memcpy(&pixel, actual.data() + y * rowBytes + x * 4, sizeof(pixel));
+							}
+
+							auto set = (mono[y * width / 8 + (x >> 3)] >> (x & 0x07)) & 0x01;
+							TEST_ASSERT_EQUAL_HEX32(set ? f.foreground : f.background, pixel);
+						}
+					}
+				}
+			}
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"colour\":\"white\",\"orientation\":\"cocktail\",\"scale\":1}"));
+	}
+
+	void test_BlitVRAMOverlay()
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		// The RGB332 colour of each upright pixel under the invaders overlay
+		auto gel = [](int ux, int uy) -> uint8_t
+		{
+			if (uy >= 240 && ux >= 16 && ux < 136) return 0x1C;
+			if (uy >= 184 && uy < 240) return 0x1C;
+			if (uy >= 32 && uy < 64) return 0xE0;
+			return 0xFF;
+		};
+
+		for (auto orientation : { "cocktail", "upright" })
+		{
+			for (auto scale : { 1, 2 })
+			{
+				char options[96];
+				snprintf(options, sizeof(options), "{\"bpp\":1,\"orientation\":\"%s\",\"overlay\":\"none\",\"scale\":%d}", orientation, scale);
+				TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions(options));
+
+				auto width = i8080ArcadeIO->GetVRAMWidth();
+				auto height = i8080ArcadeIO->GetVRAMHeight();
+				auto mono = std::vector<uint8_t>(width / 8 * height);
+				i8080ArcadeIO->BlitVRAM(std::span(mono), width / 8, std::span(srcVRAM));
+
+				TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":8,\"colour\":\"white\",\"overlay\":\"invaders\"}"));
+				auto actual = std::vector<uint8_t>(width * height);
+				i8080ArcadeIO->BlitVRAM(std::span(actual), width, std::span(srcVRAM));
+
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						// Map the destination pixel back to the upright screen
+						auto ux = x / scale;
+						auto uy = y / scale;
+
+						if (strcmp(orientation, "cocktail") == 0)
+						{
+							ux = y / scale;
+							uy = 255 - x / scale;
+						}
+
+						auto set = (mono[y * width / 8 + (x >> 3)] >> (x & 0x07)) & 0x01;
+						TEST_ASSERT_EQUAL_UINT8(set ? gel(ux, uy) : 0, actual[y * width + x]);
+					}
+				}
+			}
+		}
+
+		// A user defined band replaces the preset
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"orientation\":\"upright\",\"overlay\":[{\"x\":8,\"y\":16,\"width\":8,\"height\":8,\"colour\":\"03\"}],\"scale\":1}"));
+		auto actual = std::vector<uint8_t>(224 * 256);
+		std::fill(srcVRAM.begin(), srcVRAM.end(), 0xFF);
+		i8080ArcadeIO->BlitVRAM(std::span(actual), 224, std::span(srcVRAM));
+
+		for (int y = 0; y < 256; y++)
+		{
+			for (int x = 0; x < 224; x++)
+			{
+				TEST_ASSERT_EQUAL_UINT8(x >= 8 && x < 16 && y >= 16 && y < 24 ? 0x03 : 0xFF, actual[y * 224 + x]);
+			}
+		}
+
+		TEST_ASSERT_TRUE(i8080ArcadeIO->SetOptions("{\"overlay\":[{\"x\":4,\"y\":0,\"width\":8,\"height\":8}]}"));
+		TEST_ASSERT_TRUE(i8080ArcadeIO->SetOptions("{\"overlay\":[{\"x\":0,\"y\":256,\"width\":8,\"height\":8}]}"));
+		TEST_ASSERT_TRUE(i8080ArcadeIO->SetOptions("{\"overlay\":\"galaxians\"}"));
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\",\"overlay\":\"none\"}"));
+	}
+
+	void test_BlitVRAMHalf()
+	{
+		auto srcVRAM = std::vector<uint8_t>(7168);
+
+		for (int i = 0; i < 7168; i++)
+		{
+			srcVRAM[i] = static_cast<uint8_t>(i * 37 + (i >> 5));
+		}
+
+		for (auto options : { "{\"bpp\":1,\"orientation\":\"cocktail\"}", "{\"bpp\":8,\"orientation\":\"cocktail\"}", "{\"bpp\":1,\"orientation\":\"upright\"}", "{\"bpp\":8,\"orientation\":\"upright\"}" })
+		{
+			TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions(options));
+			auto width = i8080ArcadeIO->GetVRAMWidth();
+			auto height = i8080ArcadeIO->GetVRAMHeight();
+			auto rowBytes = width + 8;
+			auto upright = height > width;
+			auto expected = std::vector<uint8_t>(rowBytes * height);
+			auto actual = expected;
+
+			i8080ArcadeIO->BlitVRAM(std::span(expected), rowBytes, std::span(srcVRAM));
+
+			// No interrupt, nothing to blit
+			auto rect = i8080ArcadeIO->BlitVRAMHalf(std::span(actual), rowBytes, std::span(srcVRAM), 0);
+			TEST_ASSERT_EQUAL_INT(0, rect.width * rect.height);
+			TEST_ASSERT_TRUE(std::all_of(actual.begin(), actual.end(), [](uint8_t b) { return b == 0; }));
+
+			// Mid screen, the source scanlines the beam has drawn by scanline 94
+			rect = i8080ArcadeIO->BlitVRAMHalf(std::span(actual), rowBytes, std::span(srcVRAM), 1);
+			TEST_ASSERT_EQUAL_INT(0, rect.x);
+			TEST_ASSERT_EQUAL_INT(0, rect.y);
+			TEST_ASSERT_EQUAL_INT(upright ? 88 : 256, rect.width);
+			TEST_ASSERT_EQUAL_INT(upright ? 256 : 88, rect.height);
+			TEST_ASSERT_FALSE(expected == actual);
+
+			// Vblank, the rest completes the frame
+			rect = i8080ArcadeIO->BlitVRAMHalf(std::span(actual), rowBytes, std::span(srcVRAM), 2);
+			TEST_ASSERT_EQUAL_INT(upright ? 88 : 0, rect.x);
+			TEST_ASSERT_EQUAL_INT(upright ? 0 : 88, rect.y);
+			TEST_ASSERT_EQUAL_INT(upright ? 136 : 256, rect.width);
+			TEST_ASSERT_EQUAL_INT(upright ? 256 : 136, rect.height);
+			TEST_ASSERT_TRUE(expected == actual);
+		}
+
+		TEST_ASSERT_FALSE(i8080ArcadeIO->SetOptions("{\"bpp\":1,\"orientation\":\"cocktail\"}"));
+	}
 #endif
 } // namespace meen_hw::tests
 
@@ -357,14 +1619,38 @@ int main(void)
 		UNITY_BEGIN();
 		RUN_TEST(meen_hw::tests::test_Version);
 		RUN_TEST(meen_hw::tests::test_ResourcePool);
+		RUN_TEST(meen_hw::tests::test_LockFreeResourcePool);
+		RUN_TEST(meen_hw::tests::test_LockFreeIndexStack);
+		RUN_TEST(meen_hw::tests::test_HandleResourcePool);
+		RUN_TEST(meen_hw::tests::test_FixedResourcePool);
+		RUN_TEST(meen_hw::tests::test_ResourcePoolStats);
+		RUN_TEST(meen_hw::tests::test_AcquireResource);
+		RUN_TEST(meen_hw::tests::test_ResourcePoolMagazine);
+		RUN_TEST(meen_hw::tests::test_LockTypes);
+		RUN_TEST(meen_hw::tests::test_TripleBuffer);
+		RUN_TEST(meen_hw::tests::test_RingBuffer);
+		RUN_TEST(meen_hw::tests::test_FramePacer);
 #ifdef ENABLE_MH_I8080ARCADE
 		RUN_TEST(meen_hw::tests::test_ReadPort0);
 		RUN_TEST(meen_hw::tests::test_WriteAudioPorts);
 		RUN_TEST(meen_hw::tests::test_ShiftRegister);
 		RUN_TEST(meen_hw::tests::test_GenerateInterrupt);
+		RUN_TEST(meen_hw::tests::test_GenerateInterruptCycles);
+		RUN_TEST(meen_hw::tests::test_FrameSkip);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMToBeam);
+		RUN_TEST(meen_hw::tests::test_RenderAudio);
 		RUN_TEST(meen_hw::tests::test_SetOptions);
 		RUN_TEST(meen_hw::tests::test_GetVRAMDimensions);
+		RUN_TEST(meen_hw::tests::test_ExpandKernels);
 		RUN_TEST(meen_hw::tests::test_BlitVRAM);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMRgb332Pattern);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMUprightPattern);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMIncremental);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMParallel);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMScaled);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMFormats);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMOverlay);
+		RUN_TEST(meen_hw::tests::test_BlitVRAMHalf);
 #endif
 		err = meen_hw::tests::suiteTearDown(UNITY_END());
 